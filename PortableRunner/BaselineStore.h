@@ -0,0 +1,105 @@
+#ifndef TDD_BASELINESTORE_H
+#define TDD_BASELINESTORE_H
+
+// A TDD::BaselineStore kept in a text file, one "<key> <nanoseconds per call>" line per baseline, sorted by key, so that
+// it can live in the repo and changes to it show up as readable diffs. The number is after the key's last space (a key
+// may have spaces in it). Lines starting with # are comments, which are kept, at the top, when the file is saved.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "..\shared\tdd.h"
+#include "MappedFile.h"
+
+class TextBaselineStore : public TDD::BaselineStore
+{
+	const std::string             m_path;
+	const bool                    m_recording;
+	std::map<std::string, double> m_baselines;
+
+	std::mutex                    m_mutex; // updates may come from several threads
+	std::map<std::string, double> m_updates;
+
+	static std::map<std::string, double> Load(const std::string& path, std::vector<std::string>* comments = nullptr)
+	{
+		std::map<std::string, double> baselines;
+		std::ifstream in(path);
+		for (std::string line; std::getline(in, line); ) {
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (!line.empty() && line[0] == '#' && comments)
+				comments->push_back(line);
+			if (line.empty() || line[0] == '#')
+				continue;
+			const size_t space = line.find_last_of(' ');
+			if (space == std::string::npos || space == 0)
+				continue;
+			char* end = nullptr;
+			const double ns = strtod(line.c_str() + space + 1, &end);
+			if (end != line.c_str() + space + 1 && *end == 0)
+				baselines[line.substr(0, space)] = ns;
+		}
+		return baselines;
+	}
+
+public:
+	TextBaselineStore(const std::string& path, bool recording) : m_path(path), m_recording(recording), m_baselines(Load(path)) {}
+
+	bool Find(const char* key, double& nanoseconds) override
+	{
+		const auto i = m_baselines.find(key);
+		if (i == m_baselines.end())
+			return false;
+		nanoseconds = i->second;
+		return true;
+	}
+	void Update(const char* key, double nanoseconds) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_updates[key] = nanoseconds;
+	}
+	bool Recording() const override { return m_recording; }
+
+	// merges the updates into the file, as MappedSnapshotStore::Save does
+	bool Save()
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_updates.empty())
+			return true;
+
+		FileLock lock(m_path + ".lock");
+		std::vector<std::string> comments;
+		std::map<std::string, double> merged = Load(m_path, &comments);
+		if (comments.empty())
+			comments = { "# performance baselines for Assert::NoSlowerThanBaseline: <group>.<test>.<name> <median nanoseconds per call>",
+			             "# recorded by PortableRunner --record-baselines" };
+		for (const auto& u : m_updates)
+			merged[u.first] = u.second;
+
+		const std::string temp = m_path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::trunc);
+			for (const auto& c : comments)
+				out << c << '\n';
+			for (const auto& m : merged)
+				out << m.first << ' ' << std::setprecision(6) << m.second << '\n';
+			if (!out.flush())
+				return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(temp, m_path, ec);
+		if (!ec) {
+			m_baselines = merged;
+			m_updates.clear();
+		}
+		return !ec;
+	}
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef TDD_BISECT_H
+#define TDD_BISECT_H
+
+// PortableRunner --bisect=<group>.<test> [--shuffle=<seed>]: for a test which fails only when other tests run before it
+// (e.g., in a shuffled order), finds the earlier test which makes it fail, i.e., which leaves behind state it depends on.
+// Each attempt runs in a forked child, so nothing one attempt does can affect the next.
+
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+ #include <fcntl.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+
+inline std::string FullName(const TDD::UnitTestInfo& uti) { return std::string(uti.group) + "." + uti.testname; }
+
+// escapes newlines, tabs and backslashes, so a string fits in one tab-separated field of a line
+inline std::string Escape(const std::string& s)
+{
+	std::string e;
+	for (char c : s)
+		e += c == '\n' ? std::string("\\n") : c == '\t' ? std::string("\\t") : c == '\\' ? std::string("\\\\") : std::string(1, c);
+	return e;
+}
+inline std::string Unescape(const std::string& e)
+{
+	std::string s;
+	for (size_t i = 0; i < e.size(); ++i) {
+		if (e[i] == '\\' && i + 1 < e.size()) {
+			const char c = e[++i];
+			s += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+		} else {
+			s += e[i];
+		}
+	}
+	return s;
+}
+
+class Selection : public TDD::Discriminator // the tests to run (or all of them), in the order drawn from the seed (if any)
+{
+	const unsigned long long     m_seed;
+	const std::set<std::string>* m_wanted;
+	std::vector<std::string>*    m_listed;
+public:
+	explicit Selection(unsigned long long seed, const std::set<std::string>* wanted = nullptr) : m_seed(seed), m_wanted(wanted), m_listed(nullptr) {}
+
+	void ListInstead(std::vector<std::string>& listed) { m_listed = &listed; } // record the order in which they'd run, but run none
+
+	bool WantTest(const TDD::UnitTestInfo& uti) override
+	{
+		if (m_listed) {
+			m_listed->push_back(FullName(uti));
+			return false;
+		}
+		return !m_wanted || m_wanted->count(FullName(uti)) != 0;
+	}
+	unsigned long long Shuffle() override { return m_seed; }
+};
+
+class Bisector
+{
+public:
+	typedef std::function<void(TDD::Discriminator&, TDD::Reporter&)> RunAll; // the runner's tests, and those in its libraries
+
+	Bisector(const std::string& target, unsigned long long seed, RunAll runAll) : m_target(target), m_seed(seed), m_runAll(runAll), m_runs(0) {}
+
+	void Bisect(std::ostream& out)
+	{
+	#ifdef _WIN32
+		out << "--bisect isn't supported on Windows, which has no fork()\n";
+	#else
+		std::vector<std::string> order;
+		{
+			Selection list(m_seed);
+			list.ListInstead(order);
+			NullReporter r;
+			m_runAll(list, r);
+		}
+		std::vector<std::string> candidates;
+		for (const auto& name : order) {
+			if (name == m_target)
+				break;
+			candidates.push_back(name);
+		}
+		if (candidates.size() == order.size()) {
+			out << "there's no test called " << m_target << "\n";
+			return;
+		}
+
+		out << "bisecting the " << candidates.size() << " tests which run before " << m_target << " (seed " << m_seed << ")\n";
+		if (Fails({})) {
+			out << m_target << " fails on its own: it doesn't depend on the tests before it\n";
+			return;
+		}
+		if (!Fails(candidates)) {
+			out << m_target << " passes after the tests before it: it doesn't fail in this order\n";
+			return;
+		}
+		while (candidates.size() > 1)
+		{
+			const std::vector<std::string> first (candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(candidates.size() / 2));
+			const std::vector<std::string> second(candidates.begin() + static_cast<std::ptrdiff_t>(candidates.size() / 2), candidates.end());
+			if (Fails(first))
+				candidates = first;
+			else if (Fails(second))
+				candidates = second;
+			else {
+				out << m_target << " fails only after a combination of these " << candidates.size() << " tests (" << m_runs << " runs):\n";
+				for (const auto& name : candidates)
+					out << "    " << name << "\n";
+				return;
+			}
+		}
+		out << m_target << " fails after " << candidates[0] << " (" << m_runs << " runs)\n";
+	#endif
+	}
+
+private:
+	const std::string        m_target;
+	const unsigned long long m_seed;
+	const RunAll             m_runAll;
+	unsigned int             m_runs;
+
+	struct NullReporter : TDD::Reporter
+	{
+		void ForEachFailure(const TDD::TestFailure&) override {}
+	};
+	struct TargetReporter : TDD::Reporter // notes whether the target ran, and failed
+	{
+		const std::string& m_target;
+		bool m_ran, m_failed;
+		explicit TargetReporter(const std::string& target) : m_target(target), m_ran(false), m_failed(false) {}
+		void ForEachTest   (const TDD::UnitTestInfo& uti) override { m_ran    |= FullName(uti) == m_target; }
+		void ForEachFailure(const TDD::TestFailure&  tf)  override { m_failed |= FullName(tf)  == m_target; }
+	private:
+		TargetReporter& operator=(const TargetReporter&) = delete;
+	};
+
+#ifndef _WIN32
+	bool Fails(const std::vector<std::string>& before) // runs those tests and then the target in a child process; a crash counts as failing
+	{
+		enum { Passed = 10, Failed = 11, DidNotRun = 12 };
+		++m_runs;
+		std::cout.flush();
+		const pid_t child = fork();
+		if (child == 0) {
+			const int devNull = open("/dev/null", O_WRONLY);
+			dup2(devNull, STDOUT_FILENO); // the tests' own output would just be noise
+			dup2(devNull, STDERR_FILENO);
+			std::set<std::string> wanted(before.begin(), before.end());
+			wanted.insert(m_target);
+			Selection selection(m_seed, &wanted);
+			TargetReporter reporter(m_target);
+			m_runAll(selection, reporter);
+			_exit(!reporter.m_ran ? DidNotRun : reporter.m_failed ? Failed : Passed);
+		}
+		int status = 0;
+		if (child < 0 || waitpid(child, &status, 0) != child)
+			return false;
+		return WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status) == Failed);
+	}
+#endif
+};
+
+#endif
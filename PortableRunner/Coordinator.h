@@ -0,0 +1,498 @@
+#ifndef TDD_COORDINATOR_H
+#define TDD_COORDINATOR_H
+
+// Spreading the test classes over several machines (or processes), with work stealing, rather than static shards:
+//
+//     PortableRunner --coordinate=<address> [--jobs=<n>] [test library...]   serves the test classes, and reports their results
+//     PortableRunner --work=<address> [--batch=<n>] [test library...]        (on each worker) runs classes until there are none left
+//
+// where <address> is host:port (or :port, for the coordinator to listen on all interfaces) or unix:<path>. The work items
+// are planned (see Schedule.h) for the expected number of workers (--jobs), and handed out longest first, preferring
+// items from modules which the worker has already set up. Each worker pulls a batch of items, and before it runs each
+// one, asks whether it's still its to run: a worker which runs out of work steals those which other workers pulled but
+// haven't started. A worker streams each item's results back, and the coordinator passes them on to its reporter once
+// the item has finished, so if a worker disconnects (crashes, or its machine goes away), the items it had are given to
+// other workers, and their results are reported once.
+//
+// The protocol is lines of text, with tabs between fields (and \t, \n and \\ escaped within them):
+//     worker:      GET <n>                      coordinator: RUN <item> <module> <group> <test>... (for each), then END; or WAIT
+//                                                            (none left to give out, but some are still running); or DONE
+//     worker:      START <item>                 coordinator: GO, or SKIP if another worker has taken it
+//     worker:      TEST|END <group> <test>, FAIL <group> <test> <file> <line> <message>, MSG <group> <test> <message>,
+//                  COUNT <group> <test> <counter>..., then FINISHED <item>
+// A worker runs each module's TEST_MODULE_INITIALIZE before the first of its items from that module, and its
+// TEST_MODULE_CLEANUP once there are no more items (printing any failure there itself: the coordinator has finished).
+// Not on Windows.
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+ #include <cerrno>
+ #include <cstdlib>
+ #include <cstring>
+ #include <netdb.h>
+ #include <netinet/in.h>
+ #include <netinet/tcp.h>
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+#include "Bisect.h"
+#include "Schedule.h"
+
+namespace Coordination
+{
+	inline std::vector<std::string> Fields(const std::string& line) // the command, then its unescaped fields
+	{
+		std::vector<std::string> fields;
+		const size_t space = line.find(' ');
+		fields.push_back(line.substr(0, space));
+		if (space == std::string::npos)
+			return fields;
+		std::istringstream rest(line.substr(space + 1));
+		for (std::string f; std::getline(rest, f, '\t'); )
+			fields.push_back(Unescape(f));
+		return fields;
+	}
+
+#ifndef _WIN32
+	class Connection // a socket, read a line at a time
+	{
+		int         m_fd;
+		std::string m_in;
+	public:
+		explicit Connection(int fd) : m_fd(fd) {}
+		~Connection() { if (m_fd >= 0) close(m_fd); }
+		int Fd() const { return m_fd; }
+
+		bool Send(const std::string& line)
+		{
+			const std::string out = line + "\n";
+			for (size_t sent = 0; sent < out.size(); ) {
+				const ssize_t n = send(m_fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				sent += static_cast<size_t>(n);
+			}
+			return true;
+		}
+		bool Receive() // reads what's there (blocking until something is); false at the end of the stream
+		{
+			char buffer[65536];
+			for (;;) {
+				const ssize_t n = recv(m_fd, buffer, sizeof(buffer), 0);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				m_in.append(buffer, static_cast<size_t>(n));
+				return true;
+			}
+		}
+		bool NextLine(std::string& line) // a complete line which has already been received
+		{
+			const size_t end = m_in.find('\n');
+			if (end == std::string::npos)
+				return false;
+			line = m_in.substr(0, end);
+			m_in.erase(0, end + 1);
+			return true;
+		}
+		bool ReadLine(std::string& line) // blocking
+		{
+			while (!NextLine(line))
+				if (!Receive())
+					return false;
+			return true;
+		}
+	private:
+		Connection(const Connection&) = delete;
+		Connection& operator=(const Connection&) = delete;
+	};
+
+	// "unix:<path>", "host:port" or ":port"; returns a socket which is listening on, or connected to, it, or -1
+	inline int Open(const std::string& address, bool listening, std::string& error)
+	{
+		if (address.rfind("unix:", 0) == 0) {
+			sockaddr_un sun;
+			memset(&sun, 0, sizeof(sun));
+			sun.sun_family = AF_UNIX;
+			const std::string path = address.substr(5);
+			if (path.size() >= sizeof(sun.sun_path)) {
+				error = "the socket's path is too long";
+				return -1;
+			}
+			memcpy(sun.sun_path, path.c_str(), path.size());
+			const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (listening)
+				unlink(path.c_str());
+			if (fd < 0 || (listening ? bind(fd, reinterpret_cast<sockaddr*>(&sun), sizeof(sun)) != 0 || listen(fd, 64) != 0
+			                         : connect(fd, reinterpret_cast<sockaddr*>(&sun), sizeof(sun)) != 0)) {
+				error = strerror(errno);
+				if (fd >= 0)
+					close(fd);
+				return -1;
+			}
+			return fd;
+		}
+
+		const size_t colon = address.rfind(':');
+		if (colon == std::string::npos) {
+			error = "expected host:port or unix:<path>";
+			return -1;
+		}
+		const std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family   = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags    = listening ? AI_PASSIVE : 0;
+		addrinfo* found = nullptr;
+		const int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+		if (rc != 0) {
+			error = gai_strerror(rc);
+			return -1;
+		}
+		int fd = -1;
+		for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+			fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+			if (fd < 0)
+				continue;
+			const int one = 1;
+			if (listening)
+				setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			else
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // START waits for its reply
+			if (listening ? bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, 64) != 0 : connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+				error = strerror(errno);
+				close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(found);
+		return fd;
+	}
+#endif
+}
+
+class Coordinator
+{
+#ifndef _WIN32
+	struct Event
+	{
+		char                     kind; // T(est), F(ailure), E(nd), M(essage), C(ounters)
+		std::vector<std::string> fields;
+	};
+	struct Worker
+	{
+		std::unique_ptr<Coordination::Connection> connection;
+		std::set<std::string>                     assigned; // given to it, and not yet finished (or taken by another worker)
+		std::map<std::string, std::vector<Event>> results;  // of the items it's running, until they finish
+		std::string                               current;  // the item it's running
+		std::set<std::string>                     modules;  // those it has run tests from, and so has set up
+	};
+
+	std::map<std::string, Schedule::Item> m_items;
+	std::deque<std::string>               m_pending;  // not given to any worker, longest first
+	std::set<std::string>                 m_finished;
+	size_t                                m_total;
+	std::vector<Worker>                   m_workers;
+	std::set<std::string>                 m_names;    // the strings the reported UnitTestInfos point to
+	TDD::Reporter&                        m_reporter;
+	std::ostream&                         m_out;
+
+	const char* Keep(const std::string& s) { return m_names.insert(s).first->c_str(); }
+
+	void Report(const std::vector<Event>& events)
+	{
+		for (const Event& e : events) {
+			TDD::UnitTestInfo uti(Keep(e.fields.size() > 1 ? e.fields[1] : ""), Keep(e.fields.size() > 2 ? e.fields[2] : ""));
+			if (e.kind == 'T')
+				m_reporter.ForEachTest(uti);
+			else if (e.kind == 'E')
+				m_reporter.ForEachTestEnd(uti);
+			else if (e.kind == 'M' && e.fields.size() > 3)
+				m_reporter.ForEachMessage(uti, e.fields[3].c_str());
+			else if (e.kind == 'F' && e.fields.size() > 5)
+				m_reporter.ForEachFailure(TDD::TestFailure(&uti, strtoul(e.fields[4].c_str(), nullptr, 10), Keep(e.fields[3]), e.fields[5].c_str()));
+			else if (e.kind == 'C' && e.fields.size() == 3 + TDD::TestCounters::Count) {
+				TDD::TestCounters counters;
+				for (int i = 0; i < TDD::TestCounters::Count; ++i)
+					counters.value[i] = strtoll(e.fields[3 + i].c_str(), nullptr, 10);
+				m_reporter.ForEachCounters(uti, counters);
+			}
+		}
+	}
+
+	// those which another worker has been given but hasn't started
+	bool Steal(Worker& thief, size_t count, std::vector<std::string>& stolen)
+	{
+		for (Worker& victim : m_workers) {
+			if (&victim == &thief || !victim.connection)
+				continue;
+			for (auto i = victim.assigned.begin(); i != victim.assigned.end() && stolen.size() < count; ) {
+				if (*i != victim.current && victim.results.count(*i) == 0) {
+					stolen.push_back(*i);
+					i = victim.assigned.erase(i);
+				} else {
+					++i;
+				}
+			}
+		}
+		return !stolen.empty();
+	}
+
+	void Disconnect(Worker& w)
+	{
+		for (auto i = w.assigned.rbegin(); i != w.assigned.rend(); ++i)
+			if (m_finished.count(*i) == 0)
+				m_pending.push_front(*i); // before the rest: they've waited longest
+		if (!w.assigned.empty())
+			m_out << "a worker disconnected: reassigning its " << w.assigned.size() << " work items\n";
+		w.assigned.clear();
+		w.results.clear();
+		w.connection.reset();
+	}
+
+	void Handle(Worker& w, const std::string& line)
+	{
+		const std::vector<std::string> f = Coordination::Fields(line);
+		const std::string& command = f[0];
+		if (command == "GET") {
+			const size_t count = f.size() > 1 ? std::max<size_t>(1, strtoul(f[1].c_str(), nullptr, 10)) : 1;
+			std::vector<std::string> batch;
+			while (!m_pending.empty() && batch.size() < count) {
+				auto next = std::find_if(m_pending.begin(), m_pending.end(), [this, &w](const std::string& id) { return w.modules.count(m_items[id].module) != 0; });
+				if (next == m_pending.end())
+					next = m_pending.begin(); // the longest, from a module it hasn't set up yet
+				batch.push_back(*next);
+				m_pending.erase(next);
+			}
+			if (batch.empty())
+				Steal(w, (count + 1) / 2, batch);
+			if (batch.empty()) {
+				w.connection->Send(m_finished.size() == m_total ? "DONE" : "WAIT");
+				return;
+			}
+			for (const auto& id : batch) {
+				const Schedule::Item& item = m_items[id];
+				w.assigned.insert(id);
+				w.modules.insert(item.module);
+				std::string run = "RUN " + Escape(id) + "\t" + Escape(item.module) + "\t" + Escape(item.group);
+				for (const auto& test : item.tests)
+					run += "\t" + Escape(test);
+				w.connection->Send(run);
+			}
+			w.connection->Send("END");
+		} else if (command == "START" && f.size() > 1) {
+			const bool mine = w.assigned.count(f[1]) != 0;
+			if (mine)
+				w.current = f[1];
+			w.connection->Send(mine ? "GO" : "SKIP");
+		} else if ((command == "TEST" || command == "END" || command == "FAIL" || command == "MSG" || command == "COUNT") && !w.current.empty()) {
+			w.results[w.current].push_back(Event{ command == "TEST" ? 'T' : command == "END" ? 'E' : command == "FAIL" ? 'F' : command == "MSG" ? 'M' : 'C', f });
+		} else if (command == "FINISHED" && f.size() > 1) {
+			if (w.assigned.erase(f[1]) && m_finished.insert(f[1]).second)
+				Report(w.results[f[1]]);
+			w.results.erase(f[1]);
+			w.current.clear();
+		}
+	}
+#endif
+
+public:
+	typedef std::function<void(const std::string& module, TDD::Discriminator&, TDD::Reporter&)> RunModule; // "" for the runner's own tests
+
+	Coordinator(const std::vector<Schedule::Item>& items, TDD::Reporter& reporter, std::ostream& out)
+	#ifndef _WIN32
+		: m_total(0), m_reporter(reporter), m_out(out)
+	#endif
+	{
+	#ifdef _WIN32
+		(void)items; (void)reporter; (void)out;
+	#else
+		for (const auto& item : items) {
+			if (!m_items.emplace(item.id, item).second) { // it would never finish, as its id would be finished already
+				m_out << "work item " << item.id << " isn't unique: not running it\n";
+				continue;
+			}
+			m_pending.push_back(item.id);
+			++m_total;
+		}
+	#endif
+	}
+
+	// serves the classes until they've all finished
+	bool Serve(const std::string& address, std::ostream& err)
+	{
+	#ifdef _WIN32
+		(void)address;
+		err << "--coordinate isn't supported on Windows\n";
+		return false;
+	#else
+		std::string error;
+		const int listener = Coordination::Open(address, true, error);
+		if (listener < 0) {
+			err << "can't listen on " << address << ": " << error << "\n";
+			return false;
+		}
+		m_out << "coordinating " << m_total << " work items on " << address << "\n";
+		while (m_finished.size() < m_total) {
+			std::vector<pollfd> fds(1, pollfd{ listener, POLLIN, 0 });
+			for (const Worker& w : m_workers)
+				fds.push_back(pollfd{ w.connection ? w.connection->Fd() : -1, POLLIN, 0 });
+			if (poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0 && errno != EINTR)
+				break;
+			for (size_t i = 1; i < fds.size(); ++i) {
+				Worker& w = m_workers[i - 1];
+				if (!w.connection || fds[i].revents == 0)
+					continue;
+				if (!w.connection->Receive()) {
+					Disconnect(w);
+					continue;
+				}
+				for (std::string line; w.connection && w.connection->NextLine(line); )
+					Handle(w, line);
+			}
+			if (fds[0].revents & POLLIN) {
+				const int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+				if (fd >= 0) {
+					auto free = std::find_if(m_workers.begin(), m_workers.end(), [](const Worker& w) { return !w.connection; });
+					if (free == m_workers.end())
+						free = m_workers.insert(m_workers.end(), Worker());
+					free->connection.reset(new Coordination::Connection(fd));
+				}
+			}
+		}
+		for (Worker& w : m_workers) // those which are waiting for work
+			if (w.connection)
+				w.connection->Send("DONE");
+		close(listener);
+		if (address.rfind("unix:", 0) == 0)
+			unlink(address.c_str() + 5);
+		return true;
+	#endif
+	}
+
+	// runs work items from the coordinator at address until it has none left
+	static bool Work(const std::string& address, unsigned int batch, const RunModule& runModule, std::ostream& err)
+	{
+	#ifdef _WIN32
+		(void)address; (void)batch; (void)runModule;
+		err << "--work isn't supported on Windows\n";
+		return false;
+	#else
+		std::string error;
+		const int fd = Coordination::Open(address, false, error);
+		if (fd < 0) {
+			err << "can't connect to " << address << ": " << error << "\n";
+			return false;
+		}
+		Coordination::Connection c(fd);
+
+		struct Streamer : TDD::Reporter // sends the results back as they happen
+		{
+			Coordination::Connection& c;
+			explicit Streamer(Coordination::Connection& connection) : c(connection) {}
+			static std::string Name(const TDD::UnitTestInfo& uti) { return Escape(uti.group) + "\t" + Escape(uti.testname); }
+			void ForEachTest   (const TDD::UnitTestInfo& uti) override { c.Send("TEST " + Name(uti)); }
+			void ForEachTestEnd(const TDD::UnitTestInfo& uti) override { c.Send("END "  + Name(uti)); }
+			void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { c.Send("MSG " + Name(uti) + "\t" + Escape(message)); }
+			void ForEachFailure(const TDD::TestFailure& tf) override
+			{
+				c.Send("FAIL " + Name(tf) + "\t" + Escape(tf.file_name) + "\t" + std::to_string(tf.line_number) + "\t" + Escape(tf.error_string));
+			}
+			void ForEachCounters(const TDD::UnitTestInfo& uti, const TDD::TestCounters& counters) override
+			{
+				std::string line = "COUNT " + Name(uti);
+				for (long long value : counters.value)
+					line += "\t" + std::to_string(value);
+				c.Send(line);
+			}
+		private:
+			Streamer& operator=(const Streamer&) = delete;
+		} streamer(c);
+
+		struct ItemSelection : Selection // leaves the module set up for the worker's next item from it
+		{
+			explicit ItemSelection(const std::set<std::string>& tests) : Selection(0, &tests) {}
+			bool KeepModuleInitialized() override { return true; }
+		};
+		struct Printer : TDD::Reporter // for TEST_MODULE_CLEANUP, after the coordinator has finished
+		{
+			std::ostream& out;
+			explicit Printer(std::ostream& o) : out(o) {}
+			void ForEachFailure(const TDD::TestFailure& tf) override
+			{
+				out << "Failure in " << tf.group << "." << tf.testname << " -\n"
+				    << tf.file_name << "(" << tf.line_number << ") : warning : Assertion failure : \"" << tf.error_string << "\"\n";
+			}
+		private:
+			Printer& operator=(const Printer&) = delete;
+		};
+		std::set<std::string> modules; // those it has run items from
+		auto CleanUp = [&modules, &runModule, &err]()
+		{
+			Printer printer(err);
+			const std::set<std::string> noTests;
+			for (const auto& module : modules) {
+				Selection none(0, &noTests); // which runs just the cleanup of a module which was set up
+				runModule(module, none, printer);
+			}
+		};
+
+		for (std::string line;;) {
+			if (!c.Send("GET " + std::to_string(batch)) || !c.ReadLine(line))
+				return CleanUp(), false;
+			if (line == "DONE")
+				return CleanUp(), true;
+			if (line == "WAIT") {
+				usleep(100000); // the last items are running elsewhere: one may yet be given back
+				continue;
+			}
+			struct Item { std::string id, module; std::set<std::string> tests; };
+			std::vector<Item> items;
+			for (; line != "END"; ) {
+				const std::vector<std::string> f = Coordination::Fields(line);
+				if (f[0] == "RUN" && f.size() > 3) {
+					items.push_back(Item{ f[1], f[2], std::set<std::string>() });
+					for (size_t i = 4; i < f.size(); ++i)
+						items.back().tests.insert(f[3] + "." + f[i]);
+				}
+				if (!c.ReadLine(line))
+					return CleanUp(), false;
+			}
+			for (const auto& item : items) {
+				if (!c.Send("START " + Escape(item.id)) || !c.ReadLine(line))
+					return CleanUp(), false;
+				if (line != "GO")
+					continue; // stolen by another worker
+				modules.insert(item.module);
+				ItemSelection selection(item.tests);
+				runModule(item.module, selection, streamer);
+				c.Send("FINISHED " + Escape(item.id));
+			}
+		}
+	#endif
+	}
+
+private:
+	Coordinator(const Coordinator&) = delete;
+	Coordinator& operator=(const Coordinator&) = delete;
+};
+
+#endif
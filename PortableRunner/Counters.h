@@ -0,0 +1,203 @@
+#ifndef TDD_COUNTERS_H
+#define TDD_COUNTERS_H
+
+// PortableRunner --counters: measures each test method with the CPU's performance counters (instructions, cycles, cache
+// and branch misses, through perf_event_open) and the OS's resource usage (page faults, context switches and growth in
+// peak RSS, through getrusage), and prints them as a table. Where the CPU's counters aren't available (e.g., in a
+// container, or with kernel.perf_event_paranoid > 2), only the software ones (CPU time, from the task clock) are used;
+// where perf_event_open isn't allowed at all, CPU time comes from getrusage too, at a microsecond's resolution.
+// The counts are for the test's own thread. Linux only.
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+ #include <cstring>
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/resource.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+
+#ifdef __linux__
+class ResourceCounters : public TDD::TestInstrument
+{
+	enum { Hardware = 4 }; // Instructions .. BranchMisses, in a group led by Instructions, so that they count over the same time
+
+	int           m_fd[Hardware];
+	int           m_taskClock;
+	unsigned long m_slot[Hardware]; // where each open counter's value comes in a read of the group
+	rusage        m_before;
+
+	static int Open(unsigned int type, unsigned long long config, int group)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size           = sizeof(attr);
+		attr.type           = type;
+		attr.config         = config;
+		attr.disabled       = group == -1 ? 1 : 0; // members follow their leader
+		attr.exclude_kernel = 1; // allowed at perf_event_paranoid 2, the usual default
+		attr.exclude_hv     = 1;
+		attr.read_format    = group == -1 && type == PERF_TYPE_HARDWARE ? PERF_FORMAT_GROUP : 0;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+	}
+	static long long Microseconds(const timeval& t) { return static_cast<long long>(t.tv_sec) * 1000000 + t.tv_usec; }
+
+public:
+	ResourceCounters() : m_taskClock(-1)
+	{
+		static const unsigned long long configs[Hardware] = { PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		unsigned long open = 0;
+		for (int i = 0; i < Hardware; ++i) {
+			m_fd[i] = m_fd[0] == -1 && i > 0 ? -1 : Open(PERF_TYPE_HARDWARE, configs[i], i == 0 ? -1 : m_fd[0]);
+			m_slot[i] = m_fd[i] == -1 ? 0 : open++;
+		}
+		m_taskClock = Open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1);
+		memset(&m_before, 0, sizeof(m_before));
+	}
+	~ResourceCounters()
+	{
+		for (int fd : m_fd)
+			if (fd != -1)
+				close(fd);
+		if (m_taskClock != -1)
+			close(m_taskClock);
+	}
+	bool HasHardwareCounters() const { return m_fd[0] != -1; }
+
+public: // TDD::TestInstrument
+	void Start() override
+	{
+		getrusage(RUSAGE_SELF, &m_before); // for the peak RSS, which is only kept for the process
+		rusage thread;
+		getrusage(RUSAGE_THREAD, &thread);
+		m_before.ru_minflt = thread.ru_minflt;
+		m_before.ru_majflt = thread.ru_majflt;
+		m_before.ru_nvcsw  = thread.ru_nvcsw;
+		m_before.ru_nivcsw = thread.ru_nivcsw;
+		m_before.ru_utime  = thread.ru_utime;
+		m_before.ru_stime  = thread.ru_stime;
+		if (m_fd[0] != -1) {
+			ioctl(m_fd[0], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+			ioctl(m_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+		if (m_taskClock != -1) {
+			ioctl(m_taskClock, PERF_EVENT_IOC_RESET,  0);
+			ioctl(m_taskClock, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+	void Stop(TDD::TestCounters& counters) override
+	{
+		if (m_taskClock != -1) {
+			ioctl(m_taskClock, PERF_EVENT_IOC_DISABLE, 0);
+			unsigned long long ns = 0;
+			if (read(m_taskClock, &ns, sizeof(ns)) == static_cast<ssize_t>(sizeof(ns)))
+				counters.value[TDD::TestCounters::CpuTimeNs] = static_cast<long long>(ns);
+		}
+		if (m_fd[0] != -1) {
+			ioctl(m_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			unsigned long long group[1 + Hardware] = {}; // the number of counters, then their values
+			if (read(m_fd[0], group, sizeof(group)) > 0)
+				for (int i = 0; i < Hardware; ++i)
+					if (m_fd[i] != -1 && m_slot[i] < group[0])
+						counters.value[TDD::TestCounters::Instructions + i] = static_cast<long long>(group[1 + m_slot[i]]);
+		}
+
+		rusage process, thread;
+		getrusage(RUSAGE_SELF,   &process);
+		getrusage(RUSAGE_THREAD, &thread);
+		counters.value[TDD::TestCounters::PageFaults]      = (thread.ru_minflt + thread.ru_majflt) - (m_before.ru_minflt + m_before.ru_majflt);
+		counters.value[TDD::TestCounters::ContextSwitches] = (thread.ru_nvcsw + thread.ru_nivcsw) - (m_before.ru_nvcsw + m_before.ru_nivcsw);
+		counters.value[TDD::TestCounters::MaxRssGrowthKb]  = process.ru_maxrss - m_before.ru_maxrss;
+		if (m_taskClock == -1)
+			counters.value[TDD::TestCounters::CpuTimeNs] = (Microseconds(thread.ru_utime) + Microseconds(thread.ru_stime)
+			                                              - Microseconds(m_before.ru_utime) - Microseconds(m_before.ru_stime)) * 1000;
+	}
+private:
+	ResourceCounters(const ResourceCounters&) = delete;
+	ResourceCounters& operator=(const ResourceCounters&) = delete;
+};
+#endif
+
+// passes everything on to another reporter, keeping each test's counters (summed over its runs) to print as a table
+class CounterTable : public TDD::Reporter
+{
+	struct Row
+	{
+		std::string       name;
+		unsigned int      runs;
+		TDD::TestCounters sum;
+	};
+	TDD::Reporter&   m_next;
+	std::vector<Row> m_rows;
+
+	static std::string Cell(long long value, unsigned int runs) // the mean, abbreviated
+	{
+		if (value < 0)
+			return "-";
+		const double mean = static_cast<double>(value) / runs;
+		const char* suffix = "";
+		double shown = mean;
+		if      (mean >= 1e9) { shown = mean / 1e9; suffix = "G"; }
+		else if (mean >= 1e6) { shown = mean / 1e6; suffix = "M"; }
+		else if (mean >= 1e4) { shown = mean / 1e3; suffix = "k"; }
+		std::ostringstream s;
+		s << std::setprecision(shown < 10 && *suffix ? 2 : 3) << shown << suffix;
+		return s.str();
+	}
+
+public:
+	explicit CounterTable(TDD::Reporter& next) : m_next(next) {}
+
+	void Print(std::ostream& out) const
+	{
+		static const char* const headings[TDD::TestCounters::Count] = { "instructions", "cycles", "cache misses", "branch misses", "cpu ms", "faults", "switches", "rss +kB" };
+		out << std::left << std::setw(40) << "test" << std::right;
+		for (const char* h : headings)
+			out << std::setw(14) << h;
+		out << "\n";
+		for (const Row& row : m_rows) {
+			out << std::left << std::setw(40) << row.name << std::right;
+			for (int i = 0; i < TDD::TestCounters::Count; ++i) {
+				long long value = row.sum.value[i];
+				if (i == TDD::TestCounters::CpuTimeNs && value >= 0) {
+					std::ostringstream ms;
+					ms << std::fixed << std::setprecision(3) << value / 1e6 / row.runs;
+					out << std::setw(14) << ms.str();
+				} else {
+					out << std::setw(14) << Cell(value, row.runs);
+				}
+			}
+			out << "\n";
+		}
+	}
+
+public: // TDD::Reporter
+	void ForEachTest   (const TDD::UnitTestInfo& uti) override { m_next.ForEachTest(uti); }
+	void ForEachFailure(const TDD::TestFailure& tf)   override { m_next.ForEachFailure(tf); }
+	void ForEachTestEnd(const TDD::UnitTestInfo& uti) override { m_next.ForEachTestEnd(uti); }
+	void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { m_next.ForEachMessage(uti, message); }
+	void ForEachCounters(const TDD::UnitTestInfo& uti, const TDD::TestCounters& counters) override
+	{
+		const std::string name = std::string(uti.group) + "." + uti.testname;
+		if (m_rows.empty() || m_rows.back().name != name)
+			m_rows.push_back(Row{ name, 0, TDD::TestCounters() });
+		Row& row = m_rows.back();
+		for (int i = 0; i < TDD::TestCounters::Count; ++i)
+			if (counters.value[i] >= 0)
+				row.sum.value[i] = (row.sum.value[i] < 0 ? 0 : row.sum.value[i]) + counters.value[i];
+		++row.runs;
+		m_next.ForEachCounters(uti, counters);
+	}
+private:
+	CounterTable& operator=(const CounterTable&) = delete;
+};
+
+#endif
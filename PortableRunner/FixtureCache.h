@@ -0,0 +1,224 @@
+#ifndef TDD_FIXTURECACHE_H
+#define TDD_FIXTURECACHE_H
+
+// PortableRunner --fixture-cache[=<file>] (default fixtures.tddcache): keeps what TDD_CACHED_FIXTURE builds in a
+// TEST_CLASS_INITIALIZE, so that later runs map it from the file rather than building it again. The fixtures are kept
+// for each build of each test binary (the runner, or a test library), by a hash of the binary's contents: rebuilding
+// the binary builds its fixtures again, and replaces the old ones. The file stays mapped for the whole run, before any
+// worker processes are forked, so they share its pages.
+//
+// File layout (native byte order):
+//     char     magic[8];          "TDDFIXT1"
+//     uint64_t count;
+//     Entry    index[count];      sorted by key, for binary search
+//     char     blobs[];           keys, then data, each starting on a 64-byte boundary, referred to by offset from the
+//                                 start of the file
+// where a key is <binary path>\t<hash of its contents>\t<group>\t<name>.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "..\shared\tdd.h"
+#include "MappedFile.h"
+
+class MappedFixtureCache
+{
+	struct Entry { uint64_t keyOffset, keySize, dataOffset, dataSize; };
+	static const char* Magic() { return "TDDFIXT1"; }
+	enum { Alignment = 64 };
+
+	class Binary : public TDD::FixtureCache // the fixtures of one build of one binary
+	{
+		MappedFixtureCache& m_cache;
+		const std::string   m_path;
+		const std::string   m_prefix;
+	public:
+		Binary(MappedFixtureCache& cache, const std::string& path, const std::string& prefix) : m_cache(cache), m_path(path), m_prefix(prefix) {}
+		bool Find(const char* group, const char* name, const void*& data, unsigned long long& size) override
+		{
+			return m_cache.Find(m_prefix + group + "\t" + name, data, size);
+		}
+		void Store(const char* group, const char* name, const void* data, unsigned long long size) override
+		{
+			m_cache.Store(m_path + "\t", m_prefix, m_prefix + group + "\t" + name, data, size);
+		}
+	private:
+		Binary& operator=(const Binary&) = delete;
+	};
+
+	const std::string                        m_path;
+	std::vector<std::unique_ptr<MappedFile>> m_files;     // the latest last: tests may still be using fixtures in earlier ones
+	const Entry*                             m_index;
+	uint64_t                                 m_count;
+	bool                                     m_handedOut; // whether a fixture in the latest file is in use
+	std::map<std::string, std::string>       m_pending;   // stored, but not yet in the file
+	std::map<std::string, std::string>       m_current;   // binary path + "\t" => the prefix of its current build's fixtures
+	std::map<std::string, std::unique_ptr<Binary>> m_binaries;
+	std::mutex                               m_mutex;
+
+	static const Entry* Index(const MappedFile& f, uint64_t& count) // nullptr if the file is empty, truncated or not a fixture cache
+	{
+		count = 0;
+		const uint64_t header = 8 + sizeof(uint64_t);
+		if (f.Size() < header || memcmp(f.Data(), Magic(), 8) != 0)
+			return nullptr;
+		const uint64_t n = *reinterpret_cast<const uint64_t*>(f.Data() + 8);
+		if (n > (f.Size() - header) / sizeof(Entry))
+			return nullptr;
+		const Entry* index = reinterpret_cast<const Entry*>(f.Data() + header);
+		for (uint64_t i = 0; i < n; ++i)
+			if (index[i].keyOffset  > f.Size() || index[i].keySize  > f.Size() - index[i].keyOffset
+			 || index[i].dataOffset > f.Size() || index[i].dataSize > f.Size() - index[i].dataOffset || index[i].dataOffset % Alignment != 0)
+				return nullptr;
+		count = n;
+		return index;
+	}
+	void Map()
+	{
+		m_files.emplace_back(new MappedFile(m_path));
+		m_index = Index(*m_files.back(), m_count);
+		m_handedOut = false;
+	}
+
+	bool Find(const std::string& key, const void*& data, unsigned long long& size)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		const MappedFile& f = *m_files.back();
+		uint64_t lo = 0, hi = m_count;
+		while (lo < hi) {
+			const uint64_t mid = lo + (hi - lo) / 2;
+			const Entry& e = m_index[mid];
+			const int c = std::string::traits_type::compare(f.Data() + e.keyOffset, key.data(), static_cast<size_t>(e.keySize < key.size() ? e.keySize : key.size()));
+			if (c == 0 && e.keySize == key.size()) {
+				data = f.Data() + e.dataOffset;
+				size = e.dataSize;
+				m_handedOut = true;
+				return true;
+			}
+			if (c < 0 || (c == 0 && e.keySize < key.size())) lo = mid + 1;
+			else                                             hi = mid;
+		}
+		return false;
+	}
+	void Store(const std::string& binary, const std::string& prefix, const std::string& key, const void* data, unsigned long long size)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_pending[key].assign(static_cast<const char*>(data), static_cast<size_t>(size));
+		m_current[binary] = prefix;
+		Flush(); // now, rather than at the end of the run, since a forked worker never gets there
+	}
+
+	// Merges the pending fixtures into the file, under an inter-process lock, dropping those of older builds of the same
+	// binaries. If the file can't be replaced (Windows can't, while it's mapped), they're kept for the next try.
+	bool Flush()
+	{
+		if (m_pending.empty())
+			return true;
+		FileLock lock(m_path + ".lock");
+		std::map<std::string, std::string> merged;
+		{
+			MappedFile current(m_path);
+			uint64_t count = 0;
+			const Entry* index = Index(current, count);
+			for (uint64_t i = 0; i < count; ++i) {
+				const std::string key(current.Data() + index[i].keyOffset, static_cast<size_t>(index[i].keySize));
+				auto binary = m_current.find(key.substr(0, key.find('\t') + 1));
+				if (binary == m_current.end() || key.compare(0, binary->second.size(), binary->second) == 0)
+					merged[key].assign(current.Data() + index[i].dataOffset, static_cast<size_t>(index[i].dataSize));
+			}
+		}
+		for (const auto& p : m_pending)
+			merged[p.first] = p.second;
+
+		const std::string temp = m_path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			const uint64_t count = merged.size();
+			out.write(Magic(), 8);
+			out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+			auto Aligned = [](uint64_t offset) { return (offset + Alignment - 1) / Alignment * Alignment; };
+			uint64_t offset = 8 + sizeof(count) + count * sizeof(Entry);
+			for (const auto& m : merged) {
+				const uint64_t dataOffset = Aligned(offset + m.first.size());
+				const Entry e = { offset, m.first.size(), dataOffset, m.second.size() };
+				out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+				offset = Aligned(dataOffset + m.second.size());
+			}
+			const char padding[Alignment] = {};
+			offset = 8 + sizeof(count) + count * sizeof(Entry);
+			for (const auto& m : merged) {
+				out.write(m.first.data(), static_cast<std::streamsize>(m.first.size()));
+				out.write(padding, static_cast<std::streamsize>(Aligned(offset + m.first.size()) - offset - m.first.size()));
+				offset = Aligned(offset + m.first.size());
+				out.write(m.second.data(), static_cast<std::streamsize>(m.second.size()));
+				out.write(padding, static_cast<std::streamsize>(Aligned(offset + m.second.size()) - offset - m.second.size()));
+				offset = Aligned(offset + m.second.size());
+			}
+			if (!out.flush())
+				return false;
+		}
+
+		if (!m_handedOut && !m_files.empty()) // nothing uses the latest mapping: let it go, so that Windows can replace the file
+			m_files.pop_back();
+		std::error_code ec;
+		std::filesystem::rename(temp, m_path, ec);
+		if (!ec)
+			m_pending.clear();
+		else
+			std::filesystem::remove(temp, ec);
+		Map();
+		return m_pending.empty();
+	}
+
+public:
+	explicit MappedFixtureCache(const std::string& path) : m_path(path), m_index(nullptr), m_count(0), m_handedOut(false)
+	{
+		Map();
+	}
+	~MappedFixtureCache()
+	{
+		m_files.clear(); // the tests have finished with their fixtures
+		Flush();
+	}
+
+	// the cache for a binary's fixtures (the path must stay the same from run to run)
+	TDD::FixtureCache* For(const std::string& binary)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		std::unique_ptr<Binary>& b = m_binaries[binary];
+		if (!b) {
+			char hash[17];
+			snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(HashContents(MappedFile(binary))));
+			b.reset(new Binary(*this, binary, binary + "\t" + hash + "\t"));
+		}
+		return b.get();
+	}
+
+	static std::string ThisExecutable(const char* argv0)
+	{
+	#ifdef _WIN32
+		char path[MAX_PATH];
+		const DWORD n = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		return n > 0 && n < MAX_PATH ? std::string(path, n) : std::string(argv0);
+	#else
+		std::error_code ec;
+		const std::filesystem::path self = std::filesystem::canonical("/proc/self/exe", ec); // Linux
+		return ec ? std::filesystem::absolute(argv0, ec).string() : self.string();
+	#endif
+	}
+
+private:
+	MappedFixtureCache(const MappedFixtureCache&) = delete;
+	MappedFixtureCache& operator=(const MappedFixtureCache&) = delete;
+};
+
+#endif
@@ -0,0 +1,505 @@
+#ifndef TDD_FUZZER_H
+#define TDD_FUZZER_H
+
+// TEST_FUZZ targets (see tdd.h). In every run, each target is given each input in its corpus: the files in
+// <corpus>/<group>.<test>/ (--corpus=<dir>, by default corpus), mapped and passed as they are, so that an input which
+// once found a bug stays a regression test.
+//
+// PortableRunner --fuzz=<group>.<test> [--fuzz-time=<s>] [--fuzz-max-len=<n>] [--fuzz-timeout=<ms>] [--jobs=<n>] runs only
+// that target, and after its corpus, fuzzes it for that long (by default 60 s) in n forked worker processes (not on
+// Windows); any still running a second after the time's up are killed. A worker
+// mutates inputs from the corpus (flipping bits, changing, inserting, erasing and copying bytes, splicing two inputs),
+// and keeps those which reach code that no input has reached before, writing them into the corpus directory, where the
+// other workers pick them up. Coverage comes from SanitizerCoverage, where the code under test (but not the runner) is
+// built with -fsanitize-coverage=trace-pc-guard (clang) or -fsanitize-coverage=trace-pc (gcc), and the runner with
+// TDD_FUZZ_COVERAGE defined, which gives it the callbacks (instrumented test libraries need the runner to export them:
+// link it with -rdynamic); without them, the workers mutate the corpus blindly.
+//
+// An input which fails an assertion (thrown or recorded), crashes the worker, or hangs (runs for longer than the timeout,
+// by default 1000 ms, when the worker is killed) is a finding. It's minimized, by removing as much of it as still fails in
+// the same way (each try in a forked child, for up to a minute), and written into the corpus directory as finding-<hash>
+// (or hang-<hash>), and the test fails on it. Each run replays a hang-<hash> in a forked child, with the timeout, so that
+// it fails the test rather than hanging the run (except on Windows).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+ #include <signal.h>
+ #include <sys/mman.h>
+ #include <sys/time.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+#include "..\shared\TddAssertStl.h"
+#include "Bisect.h"
+#include "MappedFile.h"
+
+namespace FuzzCoverage
+{
+	enum { MapSize = 1 << 16 };
+	inline unsigned char* Map() // hit counts, from the SanitizerCoverage callbacks below
+	{
+		static unsigned char s_map[MapSize];
+		return s_map;
+	}
+	inline bool& Instrumented()
+	{
+		static bool s_instrumented = false;
+		return s_instrumented;
+	}
+	// whether the run since the map was cleared hit anything, or hit it a number of times (in powers of 2), that no
+	// earlier run did; seen holds a bit for each such bucket, for each entry
+	inline bool Novel(unsigned char* seen)
+	{
+		bool novel = false;
+		const unsigned char* map = Map();
+		for (size_t i = 0; i < MapSize; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, map + i, sizeof(word));
+			if (word == 0)
+				continue;
+			for (size_t j = i; j < i + sizeof(uint64_t); ++j) {
+				const unsigned char n = map[j];
+				if (n == 0)
+					continue;
+				const unsigned char bucket = n == 1 ? 1 : n == 2 ? 2 : n == 3 ? 4 : n < 8 ? 8 : n < 16 ? 16 : n < 32 ? 32 : n < 128 ? 64 : 128;
+				if ((seen[j] & bucket) == 0) {
+					seen[j] |= bucket;
+					novel = true;
+				}
+			}
+		}
+		return novel;
+	}
+}
+
+#if defined(TDD_FUZZ_COVERAGE) && !defined(_WIN32)
+ #if defined(__clang__)
+  #define TDD_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+ #elif defined(__GNUC__) && __GNUC__ >= 12
+  #define TDD_NO_COVERAGE __attribute__((no_sanitize_coverage))
+ #else
+  #define TDD_NO_COVERAGE
+ #endif
+extern "C" TDD_NO_COVERAGE __attribute__((visibility("default"))) void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop)
+{
+	static uint32_t s_next = 0;
+	if (start == stop || *start != 0)
+		return; // already numbered
+	for (uint32_t* guard = start; guard < stop; ++guard)
+		*guard = s_next++ % FuzzCoverage::MapSize;
+	FuzzCoverage::Instrumented() = true;
+}
+extern "C" TDD_NO_COVERAGE __attribute__((visibility("default"))) void __sanitizer_cov_trace_pc_guard(uint32_t* guard)
+{
+	++FuzzCoverage::Map()[*guard];
+}
+extern "C" TDD_NO_COVERAGE __attribute__((visibility("default"))) void __sanitizer_cov_trace_pc()
+{
+	const uintptr_t pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+	++FuzzCoverage::Map()[(pc ^ (pc >> 16)) & (FuzzCoverage::MapSize - 1)];
+	FuzzCoverage::Instrumented() = true;
+}
+#endif
+
+class CorpusFuzzer : public TDD::FuzzEngine
+{
+	const std::string  m_corpus;
+	const std::string  m_target;  // the test to fuzz, or "" to replay the corpus only
+	const unsigned int m_seconds;
+	const size_t       m_maxLen;
+	const unsigned int m_timeout; // ms, for each input
+	const unsigned int m_jobs;
+	std::ostream&      m_out;
+
+	class Corpus // a target's inputs: mapped from its directory, or found since
+	{
+		struct Input { const unsigned char* data; size_t size; };
+		std::vector<Input>                       m_inputs;
+		std::vector<std::unique_ptr<MappedFile>> m_files;
+		std::deque<std::string>                  m_found;
+		std::set<std::string>                    m_names;
+	public:
+		const std::string directory;
+		explicit Corpus(const std::string& dir) : directory(dir) {}
+
+		size_t Size() const { return m_inputs.size(); }
+		const unsigned char* Data(size_t i) const { return m_inputs[i].data; }
+		size_t               Size(size_t i) const { return m_inputs[i].size; }
+
+		// maps the files which aren't in it yet, in name order
+		void Scan(std::vector<std::string>* paths = nullptr)
+		{
+			std::error_code ec;
+			std::vector<std::string> names;
+			for (std::filesystem::directory_iterator i(directory, ec), end; !ec && i != end; i.increment(ec))
+				if (i->is_regular_file(ec) && i->path().filename().string()[0] != '.')
+					names.push_back(i->path().filename().string());
+			std::sort(names.begin(), names.end());
+			for (const auto& name : names) {
+				if (!m_names.insert(name).second)
+					continue;
+				m_files.emplace_back(new MappedFile(directory + "/" + name));
+				m_inputs.push_back(Input{ reinterpret_cast<const unsigned char*>(m_files.back()->Data()), m_files.back()->Size() });
+				if (paths)
+					paths->push_back(directory + "/" + name);
+			}
+		}
+		// adds an input, and writes it into the directory (unless it's already there); returns its path
+		std::string Add(const unsigned char* data, size_t size, const char* prefix = "")
+		{
+			char name[40];
+			snprintf(name, sizeof(name), "%s%016llx", prefix, static_cast<unsigned long long>(HashContents(data, size)));
+			const std::string path = directory + "/" + name;
+			if (m_names.insert(name).second) {
+				m_found.emplace_back(reinterpret_cast<const char*>(data), size);
+				m_inputs.push_back(Input{ reinterpret_cast<const unsigned char*>(m_found.back().data()), size });
+				std::error_code ec;
+				std::filesystem::create_directories(directory, ec);
+				const std::string temp = directory + "/." + name; // renamed once it's whole, for other workers' Scans
+				std::ofstream(temp, std::ios::binary).write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+				std::filesystem::rename(temp, path, ec);
+			}
+			return path;
+		}
+	};
+
+	// gives the target an input; a failure propagates, with a message saying which input it was
+	static void Replay(TDD::FuzzTarget& target, const unsigned char* data, size_t size, const std::string& path)
+	{
+		const unsigned int recorded = TDD::Verifier::RecordedFailureCount();
+		try {
+			target.Run(data, size);
+		} catch (...) {
+			TDD::Verifier::Message(("on input " + path).c_str());
+			throw;
+		}
+		if (TDD::Verifier::RecordedFailureCount() != recorded)
+			TDD::Verifier::Message(("on input " + path).c_str());
+	}
+
+#ifndef _WIN32
+	enum Outcome { Passes = 0, Fails = 71, Crashes, Hangs }; // Fails is a worker's exit code
+	struct Shared // between the workers and this process
+	{
+		std::atomic<unsigned long long> runs;
+		std::atomic<unsigned int>       added;
+		// then, for each worker, the size and bytes of the input it's running
+	};
+	struct Slot { std::atomic<unsigned long long> run; size_t size; unsigned char data[1]; }; // run: which of its runs it's on
+	Slot& SlotOf(Shared* shared, unsigned int worker) const
+	{
+		return *reinterpret_cast<Slot*>(reinterpret_cast<char*>(shared + 1) + worker * SlotSize());
+	}
+	size_t SlotSize() const { return (offsetof(Slot, data) + m_maxLen + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot); }
+
+	static size_t Mutate(unsigned char* data, size_t size, size_t maxLen, std::mt19937_64& random, const Corpus& corpus)
+	{
+		static const uint32_t interesting[] = { 0, 1, 0x7f, 0x80, 0xff, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff };
+		auto Below = [&random](size_t n) { return n == 0 ? 0 : static_cast<size_t>(random() % n); };
+		switch (size == 0 ? 4 : random() % 8) {
+		case 0: // flip a bit
+			data[Below(size)] ^= static_cast<unsigned char>(1u << Below(8));
+			break;
+		case 1: // a random byte
+			data[Below(size)] = static_cast<unsigned char>(random());
+			break;
+		case 2: { // an interesting value, of 1, 2 or 4 bytes
+			const uint32_t value = interesting[Below(sizeof(interesting) / sizeof(interesting[0]))];
+			const size_t width = std::min<size_t>(size, size_t(1) << Below(3));
+			memcpy(data + Below(size - width + 1), &value, width);
+			break;
+		}
+		case 3: // add or subtract a little
+			data[Below(size)] += static_cast<unsigned char>(static_cast<int>(Below(35)) - 17);
+			break;
+		case 4: { // insert random bytes
+			const size_t n = std::min<size_t>(1 + Below(4), maxLen - size);
+			const size_t at = Below(size + 1);
+			memmove(data + at + n, data + at, size - at);
+			for (size_t i = 0; i < n; ++i)
+				data[at + i] = static_cast<unsigned char>(random());
+			size += n;
+			break;
+		}
+		case 5: { // erase some
+			const size_t n = 1 + Below(std::min<size_t>(size, 8));
+			const size_t at = Below(size - n + 1);
+			memmove(data + at, data + at + n, size - at - n);
+			size -= n;
+			break;
+		}
+		case 6: { // copy part of it over another part
+			const size_t n = 1 + Below(size);
+			memmove(data + Below(size - n + 1), data + Below(size - n + 1), n);
+			break;
+		}
+		default: { // splice: the rest from another input
+			if (corpus.Size() == 0)
+				break;
+			const size_t other = Below(corpus.Size());
+			const size_t at = Below(size), from = Below(corpus.Size(other) + 1);
+			const size_t n = std::min(corpus.Size(other) - from, maxLen - at);
+			memcpy(data + at, corpus.Data(other) + from, n);
+			size = at + n;
+			break;
+		}
+		}
+		return size;
+	}
+
+	// a worker: mutates inputs until the time's up (and exits 0), or one fails (and exits Fails); a crash kills it, as
+	// does the parent if a run hangs
+	void Work(TDD::FuzzTarget& target, Corpus& corpus, std::vector<unsigned char>& seen, Shared* shared, unsigned int worker, std::chrono::steady_clock::time_point deadline)
+	{
+		std::mt19937_64 random(std::chrono::steady_clock::now().time_since_epoch().count() * 31 + worker);
+		Slot& slot = SlotOf(shared, worker);
+		std::vector<unsigned char> input(m_maxLen);
+		auto rescan = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+		for (unsigned long long runs = 1; ; ++runs) {
+			size_t size = 0;
+			if (corpus.Size() != 0) {
+				const size_t base = static_cast<size_t>(random() % corpus.Size());
+				size = std::min(corpus.Size(base), m_maxLen);
+				memcpy(input.data(), corpus.Data(base), size);
+			}
+			for (unsigned int n = 1 + static_cast<unsigned int>(random() % 4); n > 0; --n)
+				size = Mutate(input.data(), size, m_maxLen, random, corpus);
+
+			memcpy(slot.data, input.data(), size);
+			slot.size = size;
+			slot.run.store(runs, std::memory_order_release);
+			memset(FuzzCoverage::Map(), 0, FuzzCoverage::MapSize);
+			const unsigned int recorded = TDD::Verifier::RecordedFailureCount();
+			try {
+				target.Run(input.data(), size);
+			} catch (...) {
+				_exit(Fails);
+			}
+			if (TDD::Verifier::RecordedFailureCount() != recorded)
+				_exit(Fails);
+			if (FuzzCoverage::Novel(seen.data())) {
+				corpus.Add(input.data(), size);
+				++shared->added;
+			}
+
+			const auto now = std::chrono::steady_clock::now();
+			if (runs % 256 == 0 || now >= deadline)
+				shared->runs += runs % 256 == 0 ? 256 : runs % 256;
+			if (now >= deadline)
+				_exit(0);
+			if (now >= rescan) { // for the other workers' finds
+				corpus.Scan();
+				rescan = now + std::chrono::seconds(1);
+			}
+		}
+	}
+
+	Outcome Try(TDD::FuzzTarget& target, const std::string& input) const // in a child, so that a crash (or a hang) doesn't end the run
+	{
+		std::cout.flush();
+		const pid_t child = fork();
+		if (child == 0) {
+			signal(SIGALRM, SIG_DFL);
+			itimerval t = {};
+			t.it_value.tv_sec  = m_timeout / 1000;
+			t.it_value.tv_usec = m_timeout % 1000 * 1000;
+			setitimer(ITIMER_REAL, &t, nullptr); // which kills it once the time's up
+			const unsigned int recorded = TDD::Verifier::RecordedFailureCount();
+			try {
+				target.Run(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+			} catch (...) {
+				_exit(Fails);
+			}
+			_exit(TDD::Verifier::RecordedFailureCount() != recorded ? Fails : Passes);
+		}
+		int status = 0;
+		if (child < 0 || waitpid(child, &status, 0) != child)
+			return Passes;
+		if (WIFSIGNALED(status))
+			return WTERMSIG(status) == SIGALRM ? Hangs : Crashes;
+		return WIFEXITED(status) && WEXITSTATUS(status) == Fails ? Fails : Passes;
+	}
+	std::string Minimize(TDD::FuzzTarget& target, std::string input, Outcome outcome) const
+	{
+		const auto until = std::chrono::steady_clock::now() + std::chrono::minutes(1); // (each try of a hang takes the timeout)
+		unsigned int tries = 0;
+		auto More = [&]() { return tries < 4096 && std::chrono::steady_clock::now() < until; };
+		for (size_t chunk = input.size(); chunk > 0 && More(); chunk /= 2)
+			for (size_t at = 0; at + chunk <= input.size() && More(); ++tries) {
+				const std::string smaller = input.substr(0, at) + input.substr(at + chunk);
+				if (Try(target, smaller) == outcome)
+					input = smaller;
+				else
+					at += chunk;
+			}
+		return input;
+	}
+
+	void Fuzz(TDD::FuzzTarget& target, Corpus& corpus, std::vector<unsigned char>& seen)
+	{
+		const unsigned int jobs = std::max(1u, m_jobs);
+		const size_t size = sizeof(Shared) + jobs * SlotSize();
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) {
+			m_out << "can't map memory to share with the fuzzing workers\n";
+			return;
+		}
+		Shared* shared = new (memory) Shared();
+	#ifdef TDD_FUZZ_COVERAGE
+		if (!FuzzCoverage::Instrumented())
+			m_out << "the code under test isn't built with -fsanitize-coverage: fuzzing " << m_target << " blindly\n";
+	#else
+		m_out << "the runner isn't built with TDD_FUZZ_COVERAGE: fuzzing " << m_target << " blindly\n";
+	#endif
+
+		const auto started = std::chrono::steady_clock::now();
+		const auto deadline = started + std::chrono::seconds(m_seconds);
+		std::vector<pid_t> workers;
+		m_out.flush();
+		std::cout.flush();
+		for (unsigned int w = 0; w < jobs; ++w) {
+			const pid_t child = fork();
+			if (child == 0)
+				Work(target, corpus, seen, shared, w, deadline); // doesn't return
+			if (child > 0)
+				workers.push_back(child);
+		}
+
+		// reaps the workers, and kills any which is on the same run for longer than the timeout (a hang), or still
+		// running a second after the deadline
+		const auto timeout = std::chrono::milliseconds(m_timeout);
+		const auto poll = std::max(std::chrono::milliseconds(1), std::min(std::chrono::milliseconds(100), timeout / 4));
+		std::vector<unsigned long long>                      runs(workers.size(), 0);
+		std::vector<std::chrono::steady_clock::time_point> since(workers.size(), started);
+		Outcome outcome = Passes;
+		std::string finding;
+		auto Found = [&](size_t w, Outcome o) { // stops all the workers
+			outcome = o;
+			const Slot& slot = SlotOf(shared, static_cast<unsigned int>(w));
+			finding.assign(reinterpret_cast<const char*>(slot.data), slot.size);
+			for (pid_t other : workers)
+				if (other > 0)
+					kill(other, SIGKILL);
+		};
+		bool late = false;
+		for (size_t left = workers.size(); left > 0; ) {
+			int status = 0;
+			const pid_t pid = waitpid(-1, &status, WNOHANG);
+			if (pid < 0)
+				break;
+			if (pid > 0) {
+				const auto w = std::find(workers.begin(), workers.end(), pid);
+				if (w == workers.end())
+					continue;
+				*w = 0; // reaped
+				--left;
+				const bool failed = WIFEXITED(status) && WEXITSTATUS(status) == Fails;
+				const bool crashed = WIFSIGNALED(status) && WTERMSIG(status) != SIGKILL;
+				if (outcome == Passes && (failed || crashed))
+					Found(static_cast<size_t>(w - workers.begin()), failed ? Fails : Crashes);
+				continue;
+			}
+			std::this_thread::sleep_for(poll);
+			const auto now = std::chrono::steady_clock::now();
+			for (size_t w = 0; w < workers.size() && outcome == Passes; ++w) {
+				const unsigned long long run = SlotOf(shared, static_cast<unsigned int>(w)).run.load(std::memory_order_acquire);
+				if (run != runs[w]) {
+					runs[w]  = run;
+					since[w] = now;
+				} else if (workers[w] > 0 && now - since[w] > timeout) {
+					Found(w, Hangs);
+				}
+			}
+			if (!late && now > deadline + timeout + std::chrono::seconds(1)) {
+				late = true;
+				for (pid_t w : workers)
+					if (w > 0)
+						kill(w, SIGKILL);
+			}
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		m_out << "fuzzed " << m_target << " for " << static_cast<unsigned int>(seconds) << " s: " << shared->runs << " runs ("
+		      << static_cast<unsigned long long>(static_cast<double>(shared->runs) / std::max(seconds, 0.001)) << "/s), " << shared->added << " inputs added to " << corpus.directory << "\n";
+		shared->~Shared();
+		munmap(memory, size);
+		if (outcome == Passes)
+			return;
+
+		const std::string minimal = Minimize(target, finding, outcome);
+		const std::string path = corpus.Add(reinterpret_cast<const unsigned char*>(minimal.data()), minimal.size(), outcome == Hangs ? "hang-" : "finding-");
+		m_out << "found an input which " << (outcome == Fails ? "fails" : outcome == Crashes ? "crashes" : "hangs") << " (" << finding.size() << " bytes, minimized to " << minimal.size() << "): " << path << "\n";
+		if (outcome == Fails)
+			Replay(target, reinterpret_cast<const unsigned char*>(minimal.data()), minimal.size(), path);
+		else if (outcome == Crashes)
+			TDD::AssertT<std::string>(__LINE__, __FILE__).Fail("the target crashes on " + path);
+		else
+			TDD::AssertT<std::string>(__LINE__, __FILE__).Fail("the target runs for longer than " + std::to_string(m_timeout) + " ms on " + path);
+	}
+	// a hang-<hash> input, in a child with the timeout, and then (if it no longer hangs) as any other
+	void ReplayHang(TDD::FuzzTarget& target, const unsigned char* data, size_t size, const std::string& path) const
+	{
+		if (Try(target, std::string(reinterpret_cast<const char*>(data), size)) == Hangs)
+			TDD::AssertT<std::string>(__LINE__, __FILE__).Fail("the target runs for longer than " + std::to_string(m_timeout) + " ms on " + path);
+		Replay(target, data, size, path);
+	}
+#endif
+
+public:
+	CorpusFuzzer(const std::string& corpus, const std::string& target, unsigned int seconds, size_t maxLen, unsigned int timeoutMs, unsigned int jobs, std::ostream& out)
+		: m_corpus(corpus), m_target(target), m_seconds(seconds), m_maxLen(std::max<size_t>(maxLen, 1)), m_timeout(std::max(timeoutMs, 1u)), m_jobs(jobs), m_out(out) {}
+
+	void Run(const TDD::UnitTestInfo& test, TDD::FuzzTarget& target) override
+	{
+		const std::string name = FullName(test);
+		Corpus corpus(m_corpus + "/" + name);
+		std::vector<std::string> paths;
+		corpus.Scan(&paths);
+		const bool fuzzing = name == m_target;
+		std::vector<unsigned char> seen(fuzzing ? FuzzCoverage::MapSize : 0);
+		for (size_t i = 0; i < corpus.Size(); ++i) {
+			if (fuzzing)
+				memset(FuzzCoverage::Map(), 0, FuzzCoverage::MapSize);
+		#ifndef _WIN32
+			if (std::filesystem::path(paths[i]).filename().string().rfind("hang-", 0) == 0)
+				ReplayHang(target, corpus.Data(i), corpus.Size(i), paths[i]);
+			else
+		#endif
+				Replay(target, corpus.Data(i), corpus.Size(i), paths[i]);
+			if (fuzzing)
+				FuzzCoverage::Novel(seen.data());
+		}
+		if (corpus.Size() == 0)
+			Replay(target, nullptr, 0, "(empty)");
+		if (!fuzzing)
+			return;
+	#ifdef _WIN32
+		m_out << "--fuzz isn't supported on Windows, which has no fork(): replayed the corpus only\n";
+	#else
+		Fuzz(target, corpus, seen);
+	#endif
+	}
+
+private:
+	CorpusFuzzer& operator=(const CorpusFuzzer&) = delete;
+};
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef TDD_IMPACT_H
+#define TDD_IMPACT_H
+
+// Test impact selection: running only the tests which ran code from the source files that have changed.
+//
+// PortableRunner --record-impact[=<map>] (default impact.tddmap) runs the tests, recording the functions each one calls
+// through the hooks which -finstrument-functions adds to the code it's given to (the code under test, and the tests, but
+// not the runner, which defines the hooks when it's built with TDD_IMPACT_HOOKS; test libraries need the runner linked
+// with -rdynamic), then writes the source files of those functions, for each test, from the debug info (by addr2line, so
+// not on Windows). What a test method calls
+// is the test's; what its class's constructor, TestInitialize, TestCleanup, TestClassInitialize, etc. call is the class's.
+// It prints what recording cost: the calls hooked on the test's thread, and about how long they took.
+//
+// PortableRunner --changed=<file> [--impact-map=<map>] runs only the tests which ran code from the files listed in <file>
+// (one to a line, or - for stdin: e.g. git diff --name-only main | PortableRunner --changed=-), or whose class did, and
+// those which the map doesn't know (e.g. new ones). A listed file matches a recorded one if either path ends with the
+// other. A listed file which isn't in the map doesn't matter if it's a C or C++ source file (no test ran code from it),
+// but anything else (a header of constants, a build file) might change any test, so then they all run.
+//
+// Map layout (numbers are LEB128 varints):
+//     char magic[8];       "TDDIMPC1"
+//     files;               then, for each, its length and path
+//     entries;             then, for each test (<group>.<test>) or class (<group>), its length and name, the number of
+//                          files, and their indexes, ascending, each as its difference from the one before
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+ #include <dlfcn.h>
+ #include <link.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+#include "Bisect.h"
+#include "MappedFile.h"
+
+namespace Impact
+{
+	inline const char* Magic() { return "TDDIMPC1"; }
+
+	inline void PutVarint(std::string& out, uint64_t v)
+	{
+		for (; v >= 0x80; v >>= 7)
+			out += static_cast<char>(v | 0x80);
+		out += static_cast<char>(v);
+	}
+	inline bool GetVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v)
+	{
+		v = 0;
+		for (unsigned int shift = 0; p < end && shift < 64; shift += 7) {
+			const unsigned char b = *p++;
+			v |= static_cast<uint64_t>(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+	inline std::string Normalized(std::string path)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+		while (path.compare(0, 2, "./") == 0)
+			path.erase(0, 2);
+		return path;
+	}
+	inline bool EndsWith(const std::string& path, const std::string& end) // at a directory boundary
+	{
+		return path.size() >= end.size() && path.compare(path.size() - end.size(), end.size(), end) == 0
+			&& (path.size() == end.size() || path[path.size() - end.size() - 1] == '/');
+	}
+
+#ifndef _WIN32
+	// The functions called so far: an open-addressed table, which the hooks fill in without locking. Each function's
+	// stamp is that of the span (a test method, or its class's setup) which last called it; a function which the current
+	// span hasn't called before goes into Touched().
+	// Everything the hooks run is here, using only the compiler's __atomic builtins, and no library code: the code under
+	// test is instrumented, and its copies of inline library functions (std::atomic's, std::mutex's) would call the hooks.
+	enum : uint32_t { Slots = 1 << 18 };
+	struct Slot
+	{
+		void*    function;
+		uint32_t stamp;
+	};
+	__attribute__((no_instrument_function)) inline Slot* Table()
+	{
+		static Slot s_table[Slots];
+		return s_table;
+	}
+	__attribute__((no_instrument_function)) inline uint32_t& Stamp() // 0 while not recording
+	{
+		static uint32_t s_stamp = 0;
+		return s_stamp;
+	}
+	__attribute__((no_instrument_function)) inline uint32_t* Touched() // slot + 1, so that 0 is one which isn't written yet
+	{
+		static uint32_t s_touched[Slots];
+		return s_touched;
+	}
+	__attribute__((no_instrument_function)) inline uint32_t& TouchedCount()
+	{
+		static uint32_t s_count = 0;
+		return s_count;
+	}
+	__attribute__((no_instrument_function)) inline unsigned long long& Calls() // on this thread, while recording
+	{
+		static thread_local unsigned long long s_calls = 0;
+		return s_calls;
+	}
+	__attribute__((no_instrument_function)) inline bool& Full()
+	{
+		static bool s_full = false;
+		return s_full;
+	}
+	__attribute__((no_instrument_function)) inline void Touch(uint32_t slot, uint32_t stamp)
+	{
+		__atomic_store_n(&Table()[slot].stamp, stamp, __ATOMIC_RELAXED);
+		const uint32_t at = __atomic_fetch_add(&TouchedCount(), 1, __ATOMIC_RELAXED);
+		if (at < Slots)
+			__atomic_store_n(&Touched()[at], slot + 1, __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&Full(), true, __ATOMIC_RELAXED);
+	}
+	__attribute__((no_instrument_function)) inline void Enter(void* function)
+	{
+		const uint32_t stamp = __atomic_load_n(&Stamp(), __ATOMIC_RELAXED);
+		if (stamp == 0)
+			return;
+		++Calls();
+		Slot* table = Table();
+		uint32_t i = static_cast<uint32_t>((reinterpret_cast<uintptr_t>(function) >> 4) * 0x9E3779B97F4A7C15ull >> 40) & (Slots - 1);
+		for (unsigned int probes = 0; probes < 64; ++probes, i = (i + 1) & (Slots - 1)) {
+			void* f = __atomic_load_n(&table[i].function, __ATOMIC_ACQUIRE);
+			if (f == nullptr && __atomic_compare_exchange_n(&table[i].function, &f, function, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				f = function;
+			if (f == function) {
+				if (__atomic_load_n(&table[i].stamp, __ATOMIC_RELAXED) != stamp)
+					Touch(i, stamp);
+				return;
+			}
+		}
+		__atomic_store_n(&Full(), true, __ATOMIC_RELAXED);
+	}
+
+	// for the recorder, not the hooks
+	inline void SetStamp(uint32_t stamp) { __atomic_store_n(&Stamp(), stamp, __ATOMIC_RELAXED); }
+	// the slots touched since the last time, into slots (or nowhere); one touched on another thread as this runs may go to
+	// either time
+	inline void TakeTouched(std::set<uint32_t>* slots)
+	{
+		const uint32_t n = std::min<uint32_t>(__atomic_exchange_n(&TouchedCount(), 0, __ATOMIC_ACQ_REL), Slots);
+		for (uint32_t i = 0; i < n; ++i) {
+			const uint32_t touched = __atomic_exchange_n(&Touched()[i], 0, __ATOMIC_ACQUIRE);
+			if (touched != 0 && slots)
+				slots->insert(touched - 1);
+		}
+	}
+#endif
+}
+
+#if defined(TDD_IMPACT_HOOKS) && !defined(_WIN32)
+extern "C" __attribute__((no_instrument_function, visibility("default"))) void __cyg_profile_func_enter(void* function, void*) { Impact::Enter(function); }
+extern "C" __attribute__((no_instrument_function, visibility("default"))) void __cyg_profile_func_exit(void*, void*) {}
+
+class ImpactRecorder : public TDD::Reporter, public TDD::TestInstrument
+{
+	TDD::Reporter*                            m_next;
+	TDD::TestInstrument* const                m_inner;   // --counters, if it's measuring too
+	std::map<std::string, std::set<uint32_t>> m_spans;   // each test's and class's functions (as slots in the table)
+	std::string                               m_owner;   // whose span it is
+	std::string                               m_test, m_group; // the test that's running
+	uint32_t                                  m_stamp;
+	bool                                      m_started;
+	std::chrono::steady_clock::time_point     m_start;
+	unsigned long long                        m_calls;   // before the tests
+
+	void Collect()
+	{
+		Impact::TakeTouched(m_owner.empty() ? nullptr : &m_spans[m_owner]);
+	}
+	void Begin(const std::string& owner)
+	{
+		Collect();
+		m_owner = owner;
+		if (++m_stamp == 0 || m_stamp == Calibration)
+			m_stamp = 1;
+		Impact::SetStamp(m_stamp);
+	}
+	enum : uint32_t { Calibration = 0xffffffff };
+	static __attribute__((noinline)) void Calibrate() {}
+
+	// runs a program, without a shell (so that its arguments needn't be quoted), for its output; 0 if it can't
+	static FILE* Spawn(const std::vector<std::string>& args, pid_t& child)
+	{
+		std::vector<char*> argv;
+		for (const auto& a : args)
+			argv.push_back(const_cast<char*>(a.c_str()));
+		argv.push_back(nullptr);
+		int fds[2];
+		if (pipe(fds) != 0)
+			return nullptr;
+		std::cout.flush();
+		child = fork();
+		if (child == 0) {
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[0]);
+			close(fds[1]);
+			execvp(argv[0], argv.data());
+			_exit(127);
+		}
+		close(fds[1]);
+		FILE* output = child > 0 ? fdopen(fds[0], "r") : nullptr;
+		if (!output)
+			close(fds[0]);
+		return output;
+	}
+
+	// the source file of each function, from the debug info of the binary it's in
+	std::map<uint32_t, std::string> Resolve(const std::set<uint32_t>& slots, std::ostream& out) const
+	{
+		std::map<std::string, std::vector<std::pair<uint32_t, uintptr_t>>> modules;
+		for (uint32_t slot : slots) {
+			void* function = __atomic_load_n(&Impact::Table()[slot].function, __ATOMIC_ACQUIRE);
+			Dl_info info;
+			if (!function || !dladdr(function, &info) || !info.dli_fname || !info.dli_fbase)
+				continue;
+			const bool relocatable = reinterpret_cast<const ElfW(Ehdr)*>(info.dli_fbase)->e_type == ET_DYN; // PIE, or a shared library
+			const uintptr_t address = reinterpret_cast<uintptr_t>(function) - (relocatable ? reinterpret_cast<uintptr_t>(info.dli_fbase) : 0);
+			modules[info.dli_fname].emplace_back(slot, address);
+		}
+		std::map<uint32_t, std::string> files;
+		for (const auto& m : modules) {
+			for (size_t first = 0; first < m.second.size(); first += 256) {
+				const size_t last = std::min(m.second.size(), first + 256);
+				std::vector<std::string> args = { "addr2line", "-e", m.first };
+				for (size_t i = first; i < last; ++i) {
+					char address[24];
+					snprintf(address, sizeof(address), "0x%llx", static_cast<unsigned long long>(m.second[i].second));
+					args.push_back(address);
+				}
+				pid_t child = -1;
+				FILE* output = Spawn(args, child);
+				if (!output) {
+					out << "can't run addr2line, to find the source files of the functions the tests called\n";
+					return files;
+				}
+				char line[4096];
+				for (size_t i = first; i < last && fgets(line, sizeof(line), output); ++i) {
+					std::string text(line);
+					text = text.substr(0, text.find_last_of(':')); // file:line, maybe with " (discriminator n)"
+					if (!text.empty() && text[0] != '?')
+						files[m.second[i].first] = Impact::Normalized(text);
+				}
+				fclose(output);
+				int status = 0;
+				waitpid(child, &status, 0);
+				if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+					out << "can't run addr2line, to find the source files of the functions the tests called\n";
+					return files;
+				}
+			}
+		}
+		return files;
+	}
+
+public:
+	explicit ImpactRecorder(TDD::TestInstrument* inner) : m_next(nullptr), m_inner(inner), m_stamp(0), m_started(false), m_calls(0) {}
+
+	void ReportTo(TDD::Reporter& next) { m_next = &next; }
+
+	// writes the map, and what recording it cost; false if it can't be written
+	bool Write(const std::string& path, std::ostream& out)
+	{
+		Collect();
+		Impact::SetStamp(0);
+		const double ms = m_started ? std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count() : 0;
+		const unsigned long long calls = Impact::Calls() - m_calls;
+
+		// what a hooked call costs, when the function has already been called in the span
+		Impact::SetStamp(Calibration);
+		const int n = 1000000;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < n; ++i)
+			Impact::Enter(reinterpret_cast<void*>(&Calibrate)); // (as the hook does)
+		const double nsEach = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+		Impact::SetStamp(0);
+		Impact::TakeTouched(nullptr);
+
+		std::set<uint32_t> slots;
+		for (const auto& s : m_spans)
+			slots.insert(s.second.begin(), s.second.end());
+		const std::map<uint32_t, std::string> functionFiles = Resolve(slots, out);
+		std::vector<std::string> files;
+		std::map<std::string, uint32_t> indexes;
+		for (const auto& f : functionFiles)
+			indexes.emplace(f.second, 0);
+		for (auto& i : indexes) {
+			i.second = static_cast<uint32_t>(files.size());
+			files.push_back(i.first);
+		}
+
+		std::string map(Impact::Magic(), 8);
+		Impact::PutVarint(map, files.size());
+		for (const auto& f : files) {
+			Impact::PutVarint(map, f.size());
+			map += f;
+		}
+		Impact::PutVarint(map, m_spans.size());
+		for (const auto& s : m_spans) {
+			std::set<uint32_t> fileIndexes;
+			for (uint32_t slot : s.second) {
+				const auto f = functionFiles.find(slot);
+				if (f != functionFiles.end())
+					fileIndexes.insert(indexes[f->second]);
+			}
+			Impact::PutVarint(map, s.first.size());
+			map += s.first;
+			Impact::PutVarint(map, fileIndexes.size());
+			uint32_t previous = 0;
+			for (uint32_t i : fileIndexes) {
+				Impact::PutVarint(map, i - previous);
+				previous = i;
+			}
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(map.data(), static_cast<std::streamsize>(map.size()));
+		if (!file.flush()) {
+			out << "can't write the impact map to " << path << "\n";
+			return false;
+		}
+
+		out << "recorded the source files (" << files.size() << ") of " << slots.size() << " functions for " << m_spans.size()
+		    << " tests and classes in " << path << " (" << map.size() << " bytes)\n"
+		    << "recording hooked " << calls << " calls on the tests' thread, taking about " << static_cast<unsigned long long>(static_cast<double>(calls) * nsEach / 1e6)
+		    << " ms (" << nsEach << " ns each) of the " << static_cast<unsigned long long>(ms) << " ms the tests took\n";
+		if (slots.empty())
+			out << "no functions were recorded: build the tests and the code under test with -finstrument-functions\n";
+		if (__atomic_load_n(&Impact::Full(), __ATOMIC_RELAXED))
+			out << "too many functions to record them all: the map is incomplete\n";
+		return true;
+	}
+
+public: // TDD::Reporter
+	void ForEachTest(const TDD::UnitTestInfo& uti) override
+	{
+		if (!m_started) {
+			m_started = true;
+			m_start = std::chrono::steady_clock::now();
+			m_calls = Impact::Calls();
+		}
+		m_test = FullName(uti);
+		m_group = uti.group;
+		Begin(m_group); // its class's setup, until the test method starts
+		m_next->ForEachTest(uti);
+	}
+	void ForEachFailure(const TDD::TestFailure& tf) override { m_next->ForEachFailure(tf); }
+	void ForEachTestEnd(const TDD::UnitTestInfo& uti) override { m_next->ForEachTestEnd(uti); }
+	void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { m_next->ForEachMessage(uti, message); }
+	void ForEachCounters(const TDD::UnitTestInfo& uti, const TDD::TestCounters& counters) override
+	{
+		if (m_inner)
+			m_next->ForEachCounters(uti, counters);
+	}
+
+public: // TDD::TestInstrument
+	void Start() override
+	{
+		Begin(m_test);
+		if (m_inner)
+			m_inner->Start();
+	}
+	void Stop(TDD::TestCounters& counters) override
+	{
+		if (m_inner)
+			m_inner->Stop(counters);
+		Begin(m_group); // TestCleanup, then maybe TestClassCleanup
+	}
+
+private:
+	ImpactRecorder(const ImpactRecorder&) = delete;
+	ImpactRecorder& operator=(const ImpactRecorder&) = delete;
+};
+#endif
+
+class ImpactMap
+{
+	MappedFile                            m_file;
+	bool                                  m_valid;
+	std::vector<std::string>              m_files;
+	struct Entry { std::string_view name; const unsigned char* indexes; uint64_t count; };
+	std::vector<Entry>                    m_entries;
+	std::unordered_set<std::string_view>  m_names;
+public:
+	explicit ImpactMap(const std::string& path) : m_file(path), m_valid(false)
+	{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(m_file.Data());
+		const unsigned char* end = p + m_file.Size();
+		if (m_file.Size() < 8 || memcmp(p, Impact::Magic(), 8) != 0)
+			return;
+		p += 8;
+		uint64_t files = 0, entries = 0, size = 0;
+		if (!Impact::GetVarint(p, end, files))
+			return;
+		for (uint64_t i = 0; i < files; ++i) {
+			if (!Impact::GetVarint(p, end, size) || size > static_cast<uint64_t>(end - p))
+				return;
+			m_files.emplace_back(reinterpret_cast<const char*>(p), static_cast<size_t>(size));
+			p += size;
+		}
+		if (!Impact::GetVarint(p, end, entries))
+			return;
+		for (uint64_t i = 0; i < entries; ++i) {
+			Entry e;
+			uint64_t index = 0;
+			if (!Impact::GetVarint(p, end, size) || size > static_cast<uint64_t>(end - p))
+				return;
+			e.name = std::string_view(reinterpret_cast<const char*>(p), static_cast<size_t>(size));
+			p += size;
+			if (!Impact::GetVarint(p, end, e.count))
+				return;
+			e.indexes = p;
+			for (uint64_t j = 0; j < e.count; ++j)
+				if (!Impact::GetVarint(p, end, index))
+					return;
+			m_entries.push_back(e);
+			m_names.insert(e.name);
+		}
+		m_valid = true;
+	}
+	bool Valid() const { return m_valid; }
+	bool Knows(const std::string& name) const { return m_names.count(name) != 0; }
+	const std::vector<std::string>& Files() const { return m_files; }
+
+	// the tests and classes which ran code from the changed files; false (with the file in unknown) if a changed file
+	// might impact any test
+	bool Impacted(const std::vector<std::string>& changed, std::set<std::string>& impacted, std::string& unknown) const
+	{
+		std::vector<bool> hit(m_files.size(), false);
+		for (const auto& c : changed) {
+			const std::string path = Impact::Normalized(c);
+			bool found = false;
+			for (size_t i = 0; i < m_files.size(); ++i)
+				if (Impact::EndsWith(m_files[i], path) || Impact::EndsWith(path, m_files[i]))
+					hit[i] = found = true;
+			const std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+			if (!found && extension != ".c" && extension != ".cc" && extension != ".cpp" && extension != ".cxx") {
+				unknown = c;
+				return false;
+			}
+		}
+		for (const Entry& e : m_entries) {
+			const unsigned char* p = e.indexes;
+			uint64_t index = 0, delta = 0;
+			for (uint64_t j = 0; j < e.count && Impact::GetVarint(p, p + 10, delta); ++j) {
+				index += delta;
+				if (index < hit.size() && hit[static_cast<size_t>(index)]) {
+					impacted.emplace(e.name);
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+private:
+	ImpactMap(const ImpactMap&) = delete;
+	ImpactMap& operator=(const ImpactMap&) = delete;
+};
+
+class ImpactSelection : public TDD::Discriminator // the tests impacted by a list of changed files
+{
+	const unsigned long long m_seed;
+	ImpactMap                m_map;
+	bool                     m_all;
+	std::set<std::string>    m_impacted;
+public:
+	ImpactSelection(const std::string& map, const std::string& changedList, unsigned long long seed, std::ostream& out) : m_seed(seed), m_map(map), m_all(true)
+	{
+		std::vector<std::string> changed;
+		std::ifstream file;
+		if (changedList != "-")
+			file.open(changedList);
+		std::istream& in = changedList == "-" ? std::cin : file;
+		for (std::string line; std::getline(in, line); )
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back(), changed.push_back(line);
+			else if (!line.empty())
+				changed.push_back(line);
+
+		std::string unknown;
+		if (!m_map.Valid())
+			out << "can't read the impact map " << map << " (record it with --record-impact): running all the tests\n";
+		else if (!m_map.Impacted(changed, m_impacted, unknown))
+			out << unknown << " isn't in the impact map, and might change any test: running all of them\n";
+		else {
+			m_all = false;
+			out << changed.size() << " changed files impact " << m_impacted.size() << " tests and classes\n";
+		}
+	}
+
+	bool WantTest(const TDD::UnitTestInfo& uti) override
+	{
+		const std::string name = FullName(uti);
+		return m_all || m_impacted.count(name) != 0 || m_impacted.count(uti.group) != 0 || !m_map.Knows(name);
+	}
+	unsigned long long Shuffle() override { return m_seed; }
+};
+
+#endif
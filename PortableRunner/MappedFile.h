@@ -0,0 +1,192 @@
+#ifndef TDD_MAPPEDFILE_H
+#define TDD_MAPPEDFILE_H
+
+// Read-only memory-mapped files, an inter-process lock for serializing rewrites of them, and files which several
+// processes can append to at once.
+// This is the only place where the runner needs OS headers for files.
+
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <sys/file.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+class MappedFile
+{
+	const char* m_data;
+	size_t      m_size;
+#ifdef _WIN32
+	HANDLE m_file, m_mapping;
+#endif
+public:
+	explicit MappedFile(const std::string& path) : m_data(nullptr), m_size(0) // a missing or empty file maps as empty
+	{
+#ifdef _WIN32
+		m_mapping = nullptr;
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			return;
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mapping)
+			return;
+		const void* p = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (p) {
+			m_data = static_cast<const char*>(p);
+			m_size = static_cast<size_t>(size.QuadPart);
+		}
+#else
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				m_data = static_cast<const char*>(p);
+				m_size = static_cast<size_t>(st.st_size);
+			}
+		}
+		close(fd); // the mapping keeps the file alive
+#endif
+	}
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_data)                         UnmapViewOfFile(m_data);
+		if (m_mapping)                      CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+		if (m_data)
+			munmap(const_cast<char*>(m_data), m_size);
+#endif
+	}
+	const char* Data() const { return m_data; }
+	size_t      Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
+
+inline uint64_t HashContents(const void* data, size_t size) // FNV-1a, for telling contents apart (not for security)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+inline uint64_t HashContents(const MappedFile& f) { return HashContents(f.Data(), f.Size()); }
+
+class AppendFile // each Append is a single write to the end of the file (unless it's cut short), so appends from several processes don't interleave
+{
+#ifdef _WIN32
+	HANDLE m_file;
+#else
+	int m_fd;
+#endif
+public:
+	explicit AppendFile(const std::string& path)
+	{
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+		m_fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+	}
+	~AppendFile()
+	{
+#ifdef _WIN32
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+#else
+		if (m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+	bool IsOpen() const
+	{
+#ifdef _WIN32
+		return m_file != INVALID_HANDLE_VALUE;
+#else
+		return m_fd >= 0;
+#endif
+	}
+	bool Append(const void* data, size_t size) // false if it couldn't all be written (and then part of it may have been)
+	{
+		const char* p = static_cast<const char*>(data);
+		while (size != 0) {
+#ifdef _WIN32
+			DWORD written = 0;
+			if (m_file == INVALID_HANDLE_VALUE || !WriteFile(m_file, p, static_cast<DWORD>(size), &written, nullptr) || written == 0)
+				return false;
+#else
+			const ssize_t written = m_fd >= 0 ? write(m_fd, p, size) : -1;
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+#endif
+			p    += written;
+			size -= static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+private:
+	AppendFile(const AppendFile&) = delete;
+	AppendFile& operator=(const AppendFile&) = delete;
+};
+
+class FileLock // exclusive, across processes (and threads), for as long as it lives
+{
+#ifdef _WIN32
+	HANDLE m_file;
+#else
+	int m_fd;
+#endif
+public:
+	explicit FileLock(const std::string& path)
+	{
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		OVERLAPPED o = {};
+		if (m_file != INVALID_HANDLE_VALUE)
+			LockFileEx(m_file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &o);
+#else
+		m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (m_fd >= 0)
+			while (flock(m_fd, LOCK_EX) != 0 && errno == EINTR) {} // retry if interrupted by a signal
+#endif
+	}
+	~FileLock()
+	{
+#ifdef _WIN32
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file); // releases the lock
+#else
+		if (m_fd >= 0)
+			close(m_fd); // releases the lock
+#endif
+	}
+private:
+	FileLock(const FileLock&) = delete;
+	FileLock& operator=(const FileLock&) = delete;
+};
+
+#endif
@@ -1,41 +1,331 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
 #include "..\shared\tdd.h"
+#include "BaselineStore.h"
+#include "Counters.h"
+#include "FixtureCache.h"
+#include "Fuzzer.h"
+#include "Impact.h"
+#include "Bisect.h"
+#include "Coordinator.h"
+#include "PortableReporter.h"
+#include "Profiler.h"
+#include "Repeat.h"
+#include "ResultLog.h"
+#include "SnapshotStore.h"
+#include "TestLibrary.h"
+#include "Trace.h"
+#include "Watcher.h"
 
-class PortableReporter : public TDD::Reporter
+struct RunnerOptions
 {
-	unsigned int m_testsRun, m_failedTests;
-	std::ostream& m_out;
-public:
-	PortableReporter(std::ostream& out = std::cout) : m_testsRun(0), m_failedTests(0), m_out(out) {}
-	virtual ~PortableReporter()
+	std::string              snapshots       = "snapshots.tddsnap";
+	bool                     updateSnapshots = false;
+	std::string              baselines       = "baselines.txt";
+	bool                     recordBaselines = false;
+	std::string              fixtures;            // a file to cache TDD_CACHED_FIXTUREs in, between runs
+	std::vector<std::string> libraries; // test libraries to load, as well as the tests linked into the runner
+	bool                     watch           = false;
+	unsigned long long       seed            = 0; // --shuffle: 0 => registration order
+	std::string              bisect;              // a test which fails only after some others: find which
+	unsigned int             repeat          = 0; // --repeat: run each test this many times, and report how often it fails
+	bool                     untilFail       = false;
+	unsigned int             jobs            = 1; // worker processes for the repetitions, or workers to plan for when coordinating
+	bool                     counters        = false; // print each test's CPU and OS resource counters
+	std::string              profile;             // a directory for each test's sampled stacks
+	std::string              log;                 // a binary log to append each test's result to
+	unsigned long long       logRun          = 0; // which run the results belong to: 0 => a new one
+	std::string              query;               // a log to summarize, rather than running tests
+	std::string              against;             // an older log to compare its latest run with
+	double                   slowerMs        = 1; // the smallest slowdown to list
+	std::string              coordinate;          // an address to serve the test classes on, to workers
+	std::string              work;                // the address of a coordinator to run test classes for
+	unsigned int             batch           = 4; // test classes to ask the coordinator for at once
+	std::string              corpus          = "corpus"; // a directory for each TEST_FUZZ's inputs
+	std::string              fuzz;                // a TEST_FUZZ to fuzz, rather than running the tests
+	unsigned int             fuzzSeconds     = 60;
+	size_t                   fuzzMaxLen      = 4096; // the longest input to make
+	unsigned int             fuzzTimeoutMs   = 1000; // for each input, before it's a hang
+	bool                     recordImpact    = false; // record the source files each test runs code from
+	std::string              impactMap       = "impact.tddmap";
+	std::string              changed;             // a list of changed files: run only the tests they impact
+	std::string              trace;               // a file for the run's timeline, in the Chrome trace event format
+
+	bool Parse(int argc, char* argv[], std::ostream& err)
 	{
-		if (m_testsRun == 0)
-			m_out << "No tests were run!!!\n";
-		else {
-			m_out << m_failedTests << " failure";
-			m_out << (m_failedTests == 1 ? "" : "s");
-			m_out << " out of " << m_testsRun;
-			m_out << (m_testsRun == 1 ? " test run\n" : " tests run\n");
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			auto Value = [&arg](const char* option) { return arg.substr(strlen(option)); };
+
+			if      (arg == "--update-snapshots")         updateSnapshots = true;
+			else if (arg == "--watch")                    watch = true;
+			else if (arg == "--fixture-cache")            fixtures = "fixtures.tddcache";
+			else if (arg.rfind("--snapshots=", 0) == 0)   snapshots = Value("--snapshots=");
+			else if (arg == "--record-baselines")         recordBaselines = true;
+			else if (arg.rfind("--baselines=", 0) == 0)   baselines = Value("--baselines=");
+			else if (arg.rfind("--fixture-cache=", 0) == 0) fixtures = Value("--fixture-cache=");
+			else if (arg == "--shuffle")                  seed = RandomSeed();
+			else if (arg.rfind("--shuffle=", 0) == 0)     seed = strtoull(Value("--shuffle=").c_str(), nullptr, 0);
+			else if (arg.rfind("--bisect=", 0) == 0)      bisect = Value("--bisect=");
+			else if (arg.rfind("--repeat=", 0) == 0)      repeat = static_cast<unsigned int>(strtoul(Value("--repeat=").c_str(), nullptr, 0));
+			else if (arg == "--until-fail")               untilFail = true;
+			else if (arg == "--counters")                 counters = true;
+			else if (arg == "--profile")                  profile = "profiles";
+			else if (arg.rfind("--profile=", 0) == 0)     profile = Value("--profile=");
+			else if (arg.rfind("--log=", 0) == 0)         log = Value("--log=");
+			else if (arg.rfind("--log-run=", 0) == 0)     logRun = strtoull(Value("--log-run=").c_str(), nullptr, 0);
+			else if (arg.rfind("--query=", 0) == 0)       query = Value("--query=");
+			else if (arg.rfind("--against=", 0) == 0)     against = Value("--against=");
+			else if (arg.rfind("--slower=", 0) == 0)      slowerMs = strtod(Value("--slower=").c_str(), nullptr);
+			else if (arg.rfind("--jobs=", 0) == 0)        jobs = static_cast<unsigned int>(strtoul(Value("--jobs=").c_str(), nullptr, 0));
+			else if (arg.rfind("--coordinate=", 0) == 0)  coordinate = Value("--coordinate=");
+			else if (arg.rfind("--work=", 0) == 0)        work = Value("--work=");
+			else if (arg.rfind("--batch=", 0) == 0)       batch = static_cast<unsigned int>(strtoul(Value("--batch=").c_str(), nullptr, 0));
+			else if (arg.rfind("--corpus=", 0) == 0)      corpus = Value("--corpus=");
+			else if (arg.rfind("--fuzz=", 0) == 0)        fuzz = Value("--fuzz=");
+			else if (arg.rfind("--fuzz-time=", 0) == 0)   fuzzSeconds = static_cast<unsigned int>(strtoul(Value("--fuzz-time=").c_str(), nullptr, 0));
+			else if (arg.rfind("--fuzz-max-len=", 0) == 0) fuzzMaxLen = static_cast<size_t>(strtoull(Value("--fuzz-max-len=").c_str(), nullptr, 0));
+			else if (arg.rfind("--fuzz-timeout=", 0) == 0) fuzzTimeoutMs = static_cast<unsigned int>(strtoul(Value("--fuzz-timeout=").c_str(), nullptr, 0));
+			else if (arg == "--record-impact")            recordImpact = true;
+			else if (arg.rfind("--record-impact=", 0) == 0) recordImpact = true, impactMap = Value("--record-impact=");
+			else if (arg.rfind("--impact-map=", 0) == 0)  impactMap = Value("--impact-map=");
+			else if (arg.rfind("--changed=", 0) == 0)     changed = Value("--changed=");
+			else if (arg == "--trace")                    trace = "trace.json";
+			else if (arg.rfind("--trace=", 0) == 0)       trace = Value("--trace=");
+			else if (arg.rfind("--", 0) != 0)             libraries.push_back(arg);
+			else {
+				err << "unknown option: " << arg << "\n"
+				    << "usage: PortableRunner [--snapshots=<file>] [--update-snapshots] [--baselines=<file>] [--record-baselines] [--fixture-cache[=<file>]] [--shuffle[=<seed>]] [--counters] [--profile[=<dir>]] [--log=<file> [--log-run=<n>]] [--trace[=<file>]] [--corpus=<dir>] [test library...]\n"
+				    << "       PortableRunner --record-impact[=<map>] [test library...]\n"
+				    << "       PortableRunner --changed=<file|-> [--impact-map=<map>] [--shuffle[=<seed>]] [test library...]\n"
+				    << "       PortableRunner --watch [--snapshots=<file>] [--impact-map=<map>] <test library>\n"
+				    << "       PortableRunner --bisect=<group>.<test> [--shuffle=<seed>] [test library...]\n"
+				    << "       PortableRunner --query=<log> [--against=<older log>] [--slower=<ms>]\n"
+				    << "       PortableRunner --repeat=<n> [--until-fail] [--jobs=<n> [--log=<file>]] [--shuffle[=<seed>]] [test library...]\n"
+				    << "       PortableRunner --coordinate=<host:port|unix:path> [--jobs=<n>] [--counters] [--log=<file>] [test library...]\n"
+				    << "       PortableRunner --work=<host:port|unix:path> [--batch=<n>] [--counters] [test library...]\n"
+				    << "       PortableRunner --fuzz=<group>.<test> [--fuzz-time=<s>] [--fuzz-max-len=<n>] [--fuzz-timeout=<ms>] [--jobs=<n>] [--corpus=<dir>] [test library...]\n";
+				return false;
+			}
+		}
+		if (watch && libraries.size() != 1) {
+			err << "--watch needs exactly one test library\n";
+			return false;
 		}
+		if (untilFail && repeat == 0)
+			repeat = 1000; // --until-fail on its own: give up on a test that hasn't failed by then
+		return true;
 	}
-	unsigned int TestsRun   () const { return m_testsRun; }
-	unsigned int TestsFailed() const { return m_failedTests; }
-
-public: // TDD::Reporter
-	virtual void ForEachTest   (const TDD::UnitTestInfo&) { ++m_testsRun; }
-	virtual void ForEachFailure(const TDD::TestFailure& tr)
+	static unsigned long long RandomSeed()
 	{
-		++m_failedTests;
-
-		m_out << "Failure in " << tr.group << "." << tr.testname << " -\n";
-		m_out << tr.file_name << "(" << tr.line_number << ") : warning : Assertion failure : \"" << tr.error_string << "\"\n";
+		std::random_device random;
+		return (static_cast<unsigned long long>(random()) << 32 | random()) % 1000000000 + 1; // short enough to retype
 	}
 };
 
-int main()
+static void Query(const RunnerOptions& options) // compares the latest run in a log with the one before it, or with the latest in another log
 {
-	PortableReporter reporter;
-	TDD::Discriminator discriminator;
-	TDD::ClassRegistrarBase::RunTests(discriminator, reporter);
+	ResultLogReader log(options.query);
+	if (log.Runs().empty()) {
+		std::cout << "no results in " << options.query << "\n";
+		return;
+	}
+	ResultLog::PrintRuns(log, std::cout);
+	if (!options.against.empty()) {
+		ResultLogReader older(options.against);
+		if (older.Runs().empty())
+			std::cout << "no results in " << options.against << "\n";
+		else
+			ResultLog::PrintDiff(older, older.Runs().back(), log, log.Runs().back(), options.slowerMs, std::cout);
+	} else if (log.Runs().size() > 1) {
+		ResultLog::PrintDiff(log, log.Runs()[log.Runs().size() - 2], log, log.Runs().back(), options.slowerMs, std::cout);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	RunnerOptions options;
+	if (!options.Parse(argc, argv, std::cerr))
+		return 0; // for VS integration, return value must be 0 (see below)
+
+	if (!options.query.empty()) {
+		Query(options);
+		return 0;
+	}
+
+	MappedSnapshotStore snapshots(options.snapshots, options.updateSnapshots);
+	TDD::SnapshotStore::Current() = &snapshots;
+	TextBaselineStore baselines(options.baselines, options.recordBaselines);
+	TDD::BaselineStore::Current() = &baselines;
+	TDD::TestInstrument* instrument = nullptr;
+#ifdef __linux__
+	std::unique_ptr<ResourceCounters> resourceCounters; // (which opens the perf events: only if they're wanted)
+	if (options.counters) {
+		resourceCounters.reset(new ResourceCounters());
+		instrument = resourceCounters.get();
+		if (!resourceCounters->HasHardwareCounters())
+			std::cout << "the CPU's performance counters aren't available (check kernel.perf_event_paranoid): counting CPU time and OS resources only\n";
+	}
+#else
+	if (options.counters)
+		std::cout << "--counters is only supported on Linux\n";
+#endif
+#if defined(TDD_IMPACT_HOOKS) && !defined(_WIN32)
+	std::unique_ptr<ImpactRecorder> impact;
+	if (options.recordImpact)
+		impact.reset(new ImpactRecorder(instrument)); // (which measures too, if it's given --counters)
+	TDD::TestInstrument* const installed = impact ? impact.get() : instrument;
+#elif defined(_WIN32)
+	if (options.recordImpact)
+		std::cout << "--record-impact isn't supported on Windows: use --changed with a map recorded elsewhere\n";
+	TDD::TestInstrument* const installed = instrument;
+#else
+	if (options.recordImpact)
+		std::cout << "--record-impact needs the runner built with TDD_IMPACT_HOOKS, which defines the -finstrument-functions hooks: not recording\n";
+	TDD::TestInstrument* const installed = instrument;
+#endif
+	TDD::TestInstrument::Current() = installed;
+	std::unique_ptr<MappedFixtureCache> fixtures;
+	if (!options.fixtures.empty()) {
+		fixtures.reset(new MappedFixtureCache(options.fixtures));
+		TDD::FixtureCache::Current() = fixtures->For(MappedFixtureCache::ThisExecutable(argv[0]));
+	}
+	std::unique_ptr<CorpusFuzzer> fuzzer; // (without one, a TEST_FUZZ is given an empty input)
+	std::error_code noCorpus;
+	if (!options.fuzz.empty() || std::filesystem::is_directory(options.corpus, noCorpus)) {
+		fuzzer.reset(new CorpusFuzzer(options.corpus, options.fuzz, options.fuzzSeconds, options.fuzzMaxLen, options.fuzzTimeoutMs, options.jobs, std::cout));
+		TDD::FuzzEngine::Current() = fuzzer.get();
+	}
+	std::unique_ptr<TraceRecorder> tracer;
+	if (!options.trace.empty()) {
+		tracer.reset(new TraceRecorder());
+		TDD::Tracer::Current() = tracer.get();
+	}
+	const TDD::LibraryHost host = { &snapshots, &baselines, installed, nullptr, fuzzer.get(), tracer.get() }; // (a watched library is rebuilt as it runs: no fixture cache)
+
+	if (options.watch) {
+		WatchMode(options.libraries[0], host, options.impactMap).RunForever(); // until interrupted
+		return 0;
+	}
+
+	const auto libraries = TestLibrary::LoadAll(options.libraries);
+	for (const auto& library : libraries)
+		if (!library->Loaded())
+			std::cout << library->Path() << "(0) : warning : can't load test library : \"" << library->Error() << "\"\n";
+
+	auto RunAll = [&libraries, &host, &fixtures](TDD::Discriminator& discriminator, TDD::Reporter& reporter)
+	{
+		TDD::ClassRegistrarBase::RunTests(discriminator, reporter);
+		for (const auto& library : libraries) {
+			if (!library->Loaded())
+				continue;
+			TDD::LibraryHost libraryHost = host;
+			libraryHost.fixtures = fixtures ? fixtures->For(library->Path()) : nullptr;
+			library->RunTests(discriminator, reporter, libraryHost);
+		}
+	};
+	auto RunModule = [&libraries, &host, &fixtures](const std::string& module, TDD::Discriminator& discriminator, TDD::Reporter& reporter)
+	{
+		if (module.empty()) {
+			TDD::ClassRegistrarBase::RunTests(discriminator, reporter);
+			return;
+		}
+		for (const auto& library : libraries) {
+			if (!library->Loaded() || library->Path() != module)
+				continue;
+			TDD::LibraryHost libraryHost = host;
+			libraryHost.fixtures = fixtures ? fixtures->For(library->Path()) : nullptr;
+			library->RunTests(discriminator, reporter, libraryHost);
+			return;
+		}
+		TDD::UnitTestInfo uti(module.c_str(), "<test library>");
+		reporter.ForEachFailure(TDD::TestFailure(&uti, __LINE__, __FILE__, "this worker hasn't loaded the test library (at this path)"));
+	};
+	auto Plan = [&libraries, &host, &options](unsigned int workers) // the work items for the parallel modes
+	{
+		std::vector<Schedule::Test> tests;
+		Schedule::List("", [](TDD::Discriminator& d, TDD::Reporter& r) { TDD::ClassRegistrarBase::RunTests(d, r); }, tests);
+		for (const auto& library : libraries)
+			if (library->Loaded())
+				Schedule::List(library->Path(), [&library, &host](TDD::Discriminator& d, TDD::Reporter& r) { library->RunTests(d, r, host); }, tests);
+		return Schedule::Plan(tests, Schedule::Durations(options.log), workers);
+	};
+
+	if (!options.bisect.empty())
+		Bisector(options.bisect, options.seed, RunAll).Bisect(std::cout);
+	else if (options.repeat != 0)
+		Repeat(RunAll, Plan(options.jobs), options.seed, options.repeat, options.untilFail, options.jobs, std::cout);
+	else if (!options.work.empty())
+		Coordinator::Work(options.work, options.batch, RunModule, std::cout);
+	else {
+		if (options.seed != 0)
+			std::cout << "shuffled with seed " << options.seed << " (rerun in this order with --shuffle=" << options.seed << ")\n";
+		PortableReporter reporter;
+		TDD::Reporter* r = &reporter;
+		std::unique_ptr<CounterTable> table;
+		if (instrument) {
+			table.reset(new CounterTable(*r));
+			r = table.get();
+		}
+		std::unique_ptr<ResultLogReporter> logger;
+		if (!options.log.empty()) {
+			const unsigned long long run = options.logRun != 0 ? options.logRun
+				: static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+			logger.reset(new ResultLogReporter(*r, options.log, run));
+			if (logger->IsOpen())
+				r = logger.get();
+			else
+				std::cout << "can't open " << options.log << " to log the results\n";
+		}
+		std::unique_ptr<Profiler> profiler;
+		if (!options.profile.empty()) {
+			profiler.reset(new Profiler(*r));
+			r = profiler.get();
+		}
+#if defined(TDD_IMPACT_HOOKS) && !defined(_WIN32)
+		if (impact) {
+			impact->ReportTo(*r);
+			r = impact.get();
+		}
+#endif
+		if (!options.coordinate.empty())
+			Coordinator(Plan(options.jobs), *r, std::cout).Serve(options.coordinate, std::cout);
+		else if (!options.changed.empty()) {
+			ImpactSelection impacted(options.impactMap, options.changed, options.seed, std::cout);
+			RunAll(impacted, *r);
+		} else {
+			const std::set<std::string> fuzzed = { options.fuzz };
+			Selection all(options.seed, options.fuzz.empty() ? nullptr : &fuzzed);
+			RunAll(all, *r);
+		}
+#if defined(TDD_IMPACT_HOOKS) && !defined(_WIN32)
+		if (impact)
+			impact->Write(options.impactMap, std::cout);
+#endif
+		if (profiler)
+			profiler->Write(options.profile, std::cout);
+		if (table)
+			table->Print(std::cout);
+	}
+	if (tracer)
+		tracer->Write(options.trace, std::cout);
+	if (options.updateSnapshots && !snapshots.Save())
+		std::cout << "failed to save snapshots to " << options.snapshots << "\n";
+	if (options.recordBaselines && !baselines.Save())
+		std::cout << "failed to save baselines to " << options.baselines << "\n";
+	TDD::SnapshotStore::Current() = nullptr;
+	TDD::BaselineStore::Current() = nullptr;
+	TDD::TestInstrument::Current() = nullptr;
+	TDD::FixtureCache::Current() = nullptr;
+	TDD::FuzzEngine::Current() = nullptr;
+	TDD::Tracer::Current() = nullptr;
 	return 0; // for VS integration, return value must be 0, or else it thinks the post-build step failed.
 }
@@ -0,0 +1,294 @@
+#ifndef TDD_PROFILER_H
+#define TDD_PROFILER_H
+
+// PortableRunner --profile[=<directory>]: samples the call stack every millisecond of CPU time, or as often as the kernel's
+// timer allows (SIGPROF, from setitimer), attributes each sample to the test which is running, and after the run writes each test's samples to
+// <directory>/<group>.<test>.folded (default directory: profiles), in the "folded stacks" format which flamegraph.pl
+// and speedscope read.
+//
+// The signal handler only walks the frame pointers from the interrupted context, copying return addresses into a
+// preallocated buffer: it calls nothing (backtrace() isn't async-signal-safe, since the unwinder takes locks), and reads
+// only within the stack of the thread which runs the tests (samples from other threads keep just the interrupted
+// function). So build the code under test and the tests with -fno-omit-frame-pointer for whole stacks. Symbols are looked
+// up after the run, with dladdr, so only functions the dynamic linker can see get names: link the runner (and test
+// libraries) with -rdynamic to see them all. Others appear as <module>+0x<offset>, for addr2line. Not on Windows.
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+ #include <cerrno>
+ #include <csignal>
+ #include <cstdio>
+ #include <cstdlib>
+ #include <cstring>
+ #include <cstdint>
+ #include <cxxabi.h>
+ #include <dlfcn.h>
+ #include <filesystem>
+ #include <fstream>
+ #include <pthread.h>
+ #include <sys/time.h>
+ #include <ucontext.h>
+#endif
+
+#include "..\shared\tdd.h"
+
+#ifndef TDD_PROFILE_MAX_SAMPLES
+ #define TDD_PROFILE_MAX_SAMPLES 16384 // at 1 kHz, over 16 seconds of CPU time; later samples are counted, but not kept
+#endif
+#ifndef TDD_PROFILE_MAX_DEPTH
+ #define TDD_PROFILE_MAX_DEPTH 64
+#endif
+
+// passes everything on to another reporter, noting which test is running for the sampler
+class Profiler : public TDD::Reporter
+{
+#ifndef _WIN32
+	struct Sample
+	{
+		int   test;  // in m_tests
+		int   depth;
+		void* pc[TDD_PROFILE_MAX_DEPTH];
+	};
+	std::vector<Sample>        m_samples; // allocated up front: the signal handler mustn't allocate
+	std::atomic<unsigned int>  m_taken;
+	std::atomic<unsigned int>  m_dropped;
+	std::atomic<int>           m_current; // index of the running test, or -1
+	std::vector<std::string>   m_tests;
+	std::map<std::string, int> m_testIndex;
+	struct sigaction           m_previous;
+
+	static std::atomic<Profiler*>& Active()
+	{
+		static std::atomic<Profiler*> s_active(nullptr);
+		return s_active;
+	}
+	struct Stack { uintptr_t low, high; };
+	static Stack& ThisThreadsStack() // set (outside the signal handler) on the thread which runs the tests; 0s elsewhere
+	{
+		static thread_local Stack t_stack = { 0, 0 };
+		return t_stack;
+	}
+	static void FindThisThreadsStack()
+	{
+		Stack& stack = ThisThreadsStack();
+		if (stack.high != 0)
+			return;
+	#if defined(__APPLE__)
+		stack.high = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(pthread_self()));
+		stack.low  = stack.high - pthread_get_stacksize_np(pthread_self());
+	#elif defined(__linux__)
+		pthread_attr_t attributes;
+		if (pthread_getattr_np(pthread_self(), &attributes) != 0)
+			return;
+		void* address = nullptr;
+		size_t size = 0;
+		if (pthread_attr_getstack(&attributes, &address, &size) == 0) {
+			stack.low  = reinterpret_cast<uintptr_t>(address);
+			stack.high = stack.low + size;
+		}
+		pthread_attr_destroy(&attributes);
+	#endif
+	}
+	// the interrupted instruction, frame pointer and stack pointer; false on an architecture this doesn't know
+	static bool Registers(const void* context, uintptr_t& pc, uintptr_t& fp, uintptr_t& sp)
+	{
+		const ucontext_t* uc = static_cast<const ucontext_t*>(context);
+	#if defined(__APPLE__) && defined(__x86_64__)
+		pc = uc->uc_mcontext->__ss.__rip; fp = uc->uc_mcontext->__ss.__rbp; sp = uc->uc_mcontext->__ss.__rsp;
+	#elif defined(__APPLE__) && defined(__aarch64__)
+		pc = uc->uc_mcontext->__ss.__pc; fp = uc->uc_mcontext->__ss.__fp; sp = uc->uc_mcontext->__ss.__sp;
+	#elif defined(__linux__) && defined(__x86_64__)
+		pc = uc->uc_mcontext.gregs[REG_RIP]; fp = uc->uc_mcontext.gregs[REG_RBP]; sp = uc->uc_mcontext.gregs[REG_RSP];
+	#elif defined(__linux__) && defined(__aarch64__)
+		pc = uc->uc_mcontext.pc; fp = uc->uc_mcontext.regs[29]; sp = uc->uc_mcontext.sp;
+	#else
+		(void)uc; (void)pc; (void)fp; (void)sp;
+		return false;
+	#endif
+		return true;
+	}
+	static void OnSignal(int, siginfo_t*, void* context) // async-signal-safe: atomics, and reads of the stack it's on
+	{
+		const int savedErrno = errno;
+		Profiler* p = Active().load(std::memory_order_acquire);
+		const int test = p ? p->m_current.load(std::memory_order_relaxed) : -1;
+		if (test >= 0) {
+			const unsigned int i = p->m_taken.fetch_add(1, std::memory_order_relaxed);
+			if (i < p->m_samples.size()) {
+				Sample& s = p->m_samples[i];
+				s.depth = 0;
+				uintptr_t pc = 0, fp = 0, sp = 0;
+				if (Registers(context, pc, fp, sp)) {
+					s.pc[s.depth++] = reinterpret_cast<void*>(pc);
+					const Stack stack = ThisThreadsStack();
+					// each frame holds the caller's frame pointer, then the return address; frames only go up the stack
+					while (s.depth < TDD_PROFILE_MAX_DEPTH && sp >= stack.low && fp >= sp && fp % sizeof(uintptr_t) == 0 && fp + 2 * sizeof(uintptr_t) <= stack.high) {
+						const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+						if (frame[1] == 0)
+							break;
+						s.pc[s.depth++] = reinterpret_cast<void*>(frame[1]);
+						if (frame[0] <= fp)
+							break;
+						fp = frame[0];
+					}
+				}
+				s.test = test;
+			} else {
+				p->m_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		errno = savedErrno;
+	}
+	static void SetTimer(long microseconds)
+	{
+		itimerval t;
+		memset(&t, 0, sizeof(t));
+		t.it_interval.tv_usec = t.it_value.tv_usec = microseconds;
+		setitimer(ITIMER_PROF, &t, nullptr);
+	}
+
+	static std::string Symbol(void* pc, bool returnAddress)
+	{
+		// a return address is just after the call: look up the call itself, in case the call was the function's last instruction
+		void* lookup = returnAddress ? static_cast<char*>(pc) - 1 : pc;
+		Dl_info info;
+		if (dladdr(lookup, &info) == 0)
+			return "[unknown]";
+		if (info.dli_sname) {
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+			free(demangled);
+			return name;
+		}
+		const std::string module = info.dli_fname ? std::filesystem::path(info.dli_fname).filename().string() : std::string("[unknown]");
+		char offset[32];
+		snprintf(offset, sizeof(offset), "+0x%llx", static_cast<unsigned long long>(static_cast<char*>(lookup) - static_cast<char*>(info.dli_fbase)));
+		return module + offset;
+	}
+	static std::string FileName(const std::string& test)
+	{
+		std::string name = test;
+		for (char& c : name)
+			if (c == '/' || c == '\\' || c == ':' || c == '<' || c == '>' || c == '*' || c == '?' || c == '"' || c == '|' || c == ' ')
+				c = '_';
+		return name + ".folded";
+	}
+#endif
+	TDD::Reporter& m_next;
+
+public:
+	explicit Profiler(TDD::Reporter& next) : m_next(next)
+	{
+	#ifndef _WIN32
+		m_samples.resize(TDD_PROFILE_MAX_SAMPLES);
+		m_taken = 0;
+		m_dropped = 0;
+		m_current = -1;
+		FindThisThreadsStack();
+
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = OnSignal;
+		action.sa_flags     = SA_RESTART | SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		Active() = this;
+		sigaction(SIGPROF, &action, &m_previous);
+		SetTimer(1000);
+	#endif
+	}
+	~Profiler()
+	{
+	#ifndef _WIN32
+		SetTimer(0);
+		sigaction(SIGPROF, &m_previous, nullptr);
+		Active() = nullptr;
+	#endif
+	}
+
+	// stops sampling, and writes a file of folded stacks for each test which was sampled
+	void Write(const std::string& directory, std::ostream& out)
+	{
+	#ifdef _WIN32
+		(void)directory;
+		out << "--profile isn't supported on Windows\n";
+	#else
+		SetTimer(0);
+		m_current = -1;
+		const unsigned int count = m_taken.load() < m_samples.size() ? m_taken.load() : static_cast<unsigned int>(m_samples.size());
+
+		std::map<void*, std::string> symbols; // symbolized once each
+		auto Name = [&symbols](void* pc, bool returnAddress) -> const std::string&
+		{
+			auto i = symbols.find(pc);
+			if (i == symbols.end())
+				i = symbols.emplace(pc, Symbol(pc, returnAddress)).first;
+			return i->second;
+		};
+
+		std::vector<std::map<std::string, unsigned int>> folded(m_tests.size());
+		for (unsigned int i = 0; i < count; ++i) {
+			const Sample& s = m_samples[i];
+			std::string stack;
+			for (int d = s.depth - 1; d >= 0; --d) { // outermost first
+				if (!stack.empty())
+					stack += ';';
+				stack += Name(s.pc[d], d != 0); // (the first is the interrupted instruction, the rest are return addresses)
+			}
+			++folded[static_cast<size_t>(s.test)][stack.empty() ? std::string("[unknown]") : stack];
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		unsigned int files = 0;
+		for (size_t t = 0; t < m_tests.size(); ++t) {
+			if (folded[t].empty())
+				continue;
+			std::ofstream file(std::filesystem::path(directory) / FileName(m_tests[t]));
+			for (const auto& f : folded[t])
+				file << f.first << ' ' << f.second << '\n';
+			files += file ? 1 : 0;
+		}
+		out << "profiled " << count << " samples into " << files << " files in " << directory;
+		if (m_dropped != 0)
+			out << " (" << m_dropped << " more samples didn't fit in TDD_PROFILE_MAX_SAMPLES)";
+		out << "\n";
+	#endif
+	}
+
+public: // TDD::Reporter
+	void ForEachTest(const TDD::UnitTestInfo& uti) override
+	{
+	#ifndef _WIN32
+		const std::string name = std::string(uti.group) + "." + uti.testname;
+		auto i = m_testIndex.find(name); // a repeated test adds to the same profile
+		if (i == m_testIndex.end()) {
+			i = m_testIndex.emplace(name, static_cast<int>(m_tests.size())).first;
+			m_tests.push_back(name);
+		}
+		FindThisThreadsStack(); // (in case this isn't the thread which made the profiler)
+		m_current.store(i->second, std::memory_order_relaxed);
+	#endif
+		m_next.ForEachTest(uti);
+	}
+	void ForEachTestEnd(const TDD::UnitTestInfo& uti) override
+	{
+	#ifndef _WIN32
+		m_current.store(-1, std::memory_order_relaxed);
+	#endif
+		m_next.ForEachTestEnd(uti);
+	}
+	void ForEachFailure(const TDD::TestFailure& tf) override { m_next.ForEachFailure(tf); }
+	void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { m_next.ForEachMessage(uti, message); }
+	void ForEachCounters(const TDD::UnitTestInfo& uti, const TDD::TestCounters& counters) override { m_next.ForEachCounters(uti, counters); }
+private:
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+};
+
+#endif
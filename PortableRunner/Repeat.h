@@ -0,0 +1,322 @@
+#ifndef TDD_REPEAT_H
+#define TDD_REPEAT_H
+
+// PortableRunner --repeat=<n> [--until-fail] [--jobs=<n>]: runs each test n times (or, with --until-fail, until it fails,
+// at most n times), and prints each test's failure rate, with a confidence interval, and the distribution of its durations.
+// The repetitions happen inside RunClassTests (see Discriminator::RunAgain), so the method tables, the reporter and
+// TestClassInitialize's state are all reused; only the test class instance is new each time. A TEST_METHOD_ASYNC's
+// repetitions don't overlap: each one finishes (see Discriminator::Repeats) before the next one starts.
+// With --jobs, the tests are split between that many forked worker processes (not on Windows), each of which runs all
+// the repetitions of its tests, so that each TestClassInitialize runs in as few of them as it can (see Schedule.h). A worker
+// sends each run's result as it finishes, so one which crashes loses nothing, and the crash counts as a failed run of the
+// test it was running.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+ #include <poll.h>
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+#include "Bisect.h"
+#include "Schedule.h"
+
+class RepeatStats : public TDD::Reporter
+{
+public:
+	struct Test
+	{
+		std::string         name;
+		unsigned int        starts = 0, runs = 0, failures = 0;
+		bool                failing = false; // in the current run
+		std::vector<double> durations;       // milliseconds
+		std::string         firstFailure;    // printed as PortableReporter would
+		std::chrono::steady_clock::time_point started;
+	};
+
+	Test& Find(const TDD::UnitTestInfo& uti) // by pointer: the names' addresses don't change between repetitions
+	{
+		const std::pair<const char*, const char*> key(uti.group, uti.testname);
+		if (m_last && m_lastKey == key)
+			return *m_last;
+		auto i = m_tests.find(key);
+		if (i == m_tests.end()) {
+			i = m_tests.emplace(key, Test()).first;
+			i->second.name = FullName(uti);
+		}
+		m_lastKey = key;
+		return *(m_last = &i->second);
+	}
+
+public: // TDD::Reporter
+	void ForEachTest(const TDD::UnitTestInfo& uti) override
+	{
+		Test& t = Find(uti);
+		++t.starts;
+		t.failing = false;
+		t.started = std::chrono::steady_clock::now();
+		m_current = &t;
+		Send("S\t" + t.name + "\n");
+	}
+	void ForEachFailure(const TDD::TestFailure& tf) override
+	{
+		// a failure in TestInitialize, etc. is reported under that name: count it against the test that's running
+		Test* t = &Find(tf);
+		if (t->starts == 0 && m_current)
+			t = m_current;
+		if (!t->failing) {
+			t->failing = true;
+			++t->failures;
+		}
+		if (t->firstFailure.empty()) {
+			std::ostringstream s;
+			s << "Failure in " << tf.group << "." << tf.testname << " -\n"
+			  << tf.file_name << "(" << tf.line_number << ") : warning : Assertion failure : \"" << tf.error_string << "\"\n";
+			t->firstFailure = s.str();
+			if (t->starts == 0) // (e.g. TestClassCleanup's, which has no end to send it with)
+				Send("F\t" + t->name + "\t" + Escape(t->firstFailure) + "\n");
+		}
+	}
+	void ForEachTestEnd(const TDD::UnitTestInfo& uti) override
+	{
+		Test& t = Find(uti);
+		++t.runs;
+		t.durations.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t.started).count());
+		if (m_current == &t)
+			m_current = nullptr;
+		if (m_stream >= 0) {
+			std::ostringstream s;
+			s << "E\t" << t.name << '\t' << (t.failing ? 1 : 0) << '\t' << t.durations.back() << '\t'
+			  << (t.failing && t.failures == 1 ? Escape(t.firstFailure) : std::string()) << '\n';
+			Send(s.str());
+		}
+	}
+
+public:
+	// for worker processes: sends a line as each test starts (S), and as each run ends (E), or as a failure outside a test
+	// is reported (F), with tabs between the fields; written straight to fd, so that a crash loses none of them
+	void StreamTo(int fd) { m_stream = fd; }
+	// one of those lines; running is the test which the worker has started, and not yet ended
+	void Merge(const std::string& line, std::string& running)
+	{
+		std::istringstream fields(line);
+		std::string kind, name, failed, ms, failure;
+		std::getline(fields, kind, '\t'); std::getline(fields, name, '\t');
+		Test& t = m_merged[name];
+		t.name = name;
+		if (kind == "S") {
+			running = name;
+		} else if (kind == "E") {
+			std::getline(fields, failed, '\t'); std::getline(fields, ms, '\t'); std::getline(fields, failure, '\t');
+			++t.runs;
+			t.failures += failed == "1" ? 1 : 0;
+			t.durations.push_back(strtod(ms.c_str(), nullptr));
+			if (t.firstFailure.empty())
+				t.firstFailure = Unescape(failure);
+			running.clear();
+		} else if (kind == "F") {
+			std::getline(fields, failure, '\t');
+			++t.failures;
+			if (t.firstFailure.empty())
+				t.firstFailure = Unescape(failure);
+		}
+	}
+	// a worker died while it was running a test: that's a failed run of the test
+	void Crashed(const std::string& running, const std::string& how)
+	{
+		Test& t = m_merged[running];
+		t.name = running;
+		++t.runs;
+		++t.failures;
+		if (t.firstFailure.empty())
+			t.firstFailure = "Failure in " + running + " -\nthe worker process running it " + how + "\n";
+	}
+
+	void Print(std::ostream& out)
+	{
+		std::vector<Test*> tests;
+		for (auto& i : m_tests)
+			tests.push_back(&i.second);
+		for (auto& i : m_merged)
+			tests.push_back(&i.second);
+		std::sort(tests.begin(), tests.end(), [](const Test* a, const Test* b) {
+			const double ra = a->runs ? double(a->failures) / a->runs : 1, rb = b->runs ? double(b->failures) / b->runs : 1;
+			return ra != rb ? ra > rb : a->name < b->name;
+		});
+
+		for (const Test* t : tests)
+			out << t->firstFailure;
+
+		out << std::left << std::setw(40) << "test" << std::right << std::setw(8) << "runs" << std::setw(10) << "failures"
+		    << std::setw(9) << "rate" << std::setw(20) << "95% interval"
+		    << std::setw(11) << "median ms" << std::setw(11) << "p90 ms" << std::setw(11) << "max ms" << "\n";
+		out << std::fixed;
+		for (Test* t : tests) {
+			if (t->runs == 0) // e.g., TestClassCleanup
+				continue;
+			const double rate = double(t->failures) / t->runs;
+			double low, high;
+			Wilson(t->failures, t->runs, low, high);
+			std::sort(t->durations.begin(), t->durations.end());
+			out << std::left << std::setw(40) << t->name << std::right << std::setw(8) << t->runs << std::setw(10) << t->failures
+			    << std::setprecision(2) << std::setw(8) << rate * 100 << "%"
+			    << std::setw(9) << low * 100 << "% - " << std::setw(5) << high * 100 << "%"
+			    << std::setprecision(3) << std::setw(11) << Percentile(t->durations, 0.5) << std::setw(11) << Percentile(t->durations, 0.9)
+			    << std::setw(11) << (t->durations.empty() ? 0.0 : t->durations.back()) << "\n";
+		}
+		out.unsetf(std::ios::fixed);
+	}
+
+private:
+	std::map<std::pair<const char*, const char*>, Test> m_tests;  // from this process
+	std::map<std::string, Test>                          m_merged; // from worker processes
+	std::pair<const char*, const char*>                  m_lastKey;
+	Test* m_last    = nullptr;
+	Test* m_current = nullptr;
+	int   m_stream  = -1;
+
+	void Send(const std::string& line) const
+	{
+	#ifndef _WIN32
+		for (size_t written = 0; m_stream >= 0 && written < line.size(); ) {
+			const ssize_t n = write(m_stream, line.data() + written, line.size() - written);
+			if (n <= 0)
+				break;
+			written += static_cast<size_t>(n);
+		}
+	#else
+		(void)line;
+	#endif
+	}
+
+	// Wilson score interval: unlike failures/runs +/- a normal approximation, it behaves when there are no (or few) failures
+	static void Wilson(unsigned int failures, unsigned int runs, double& low, double& high)
+	{
+		const double z = 1.96, n = runs, p = failures / n;
+		const double centre = (p + z * z / (2 * n)) / (1 + z * z / n);
+		const double spread = z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+		low  = std::max(0.0, centre - spread);
+		high = std::min(1.0, centre + spread);
+	}
+	static double Percentile(const std::vector<double>& sorted, double p)
+	{
+		return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+	}
+};
+
+class RepeatSelection : public Selection
+{
+	RepeatStats&       m_stats;
+	const unsigned int m_repeat;
+	const bool         m_untilFail;
+public:
+	RepeatSelection(unsigned long long seed, RepeatStats& stats, unsigned int repeat, bool untilFail, const std::set<std::string>* wanted = nullptr)
+		: Selection(seed, wanted), m_stats(stats), m_repeat(repeat), m_untilFail(untilFail) {}
+
+	bool RunAgain(const TDD::UnitTestInfo& uti) override
+	{
+		const RepeatStats::Test& t = m_stats.Find(uti);
+		return t.starts < m_repeat && !(m_untilFail && t.failures != 0);
+	}
+	bool Repeats() override { return true; } // (so each run of an asynchronous test finishes before the next one starts)
+private:
+	RepeatSelection& operator=(const RepeatSelection&) = delete;
+};
+
+// runs the repetitions, in this process or split between worker processes (by the work items), and prints the statistics
+inline void Repeat(const Bisector::RunAll& runAll, const std::vector<Schedule::Item>& items, unsigned long long seed, unsigned int repeat, bool untilFail, unsigned int jobs, std::ostream& out)
+{
+	RepeatStats stats;
+#ifdef _WIN32
+	(void)items;
+	if (jobs > 1)
+		out << "--jobs isn't supported on Windows, which has no fork(): running the repetitions here\n";
+#else
+	if (jobs > 1) {
+		struct Worker { pid_t pid; int fd; std::string pending, running; };
+		std::vector<Worker> workers;
+		std::cout.flush();
+		for (const auto& share : Schedule::Partition(items, jobs)) {
+			std::set<std::string> tests;
+			for (const Schedule::Item* item : share)
+				for (const auto& test : item->tests)
+					tests.insert(item->group + "." + test);
+			int fds[2];
+			if (tests.empty() || pipe(fds) != 0)
+				continue;
+			const pid_t child = fork();
+			if (child == 0) {
+				close(fds[0]);
+				RepeatStats mine;
+				mine.StreamTo(fds[1]);
+				RepeatSelection selection(seed, mine, repeat, untilFail, &tests);
+				runAll(selection, mine);
+				_exit(0);
+			}
+			close(fds[1]);
+			if (child > 0)
+				workers.push_back(Worker{ child, fds[0], std::string(), std::string() });
+			else
+				close(fds[0]);
+		}
+		for (size_t open = workers.size(); open > 0; ) { // (all at once, so that none waits on a full pipe)
+			std::vector<pollfd> fds;
+			for (const auto& w : workers)
+				fds.push_back(pollfd{ w.fd, POLLIN, 0 });
+			if (poll(fds.data(), fds.size(), -1) < 0)
+				continue;
+			for (size_t i = 0; i < workers.size(); ++i) {
+				Worker& w = workers[i];
+				if (w.fd < 0 || fds[i].revents == 0)
+					continue;
+				char buffer[65536];
+				const ssize_t n = read(w.fd, buffer, sizeof(buffer));
+				if (n > 0) {
+					w.pending.append(buffer, static_cast<size_t>(n));
+					size_t start = 0;
+					for (size_t end; (end = w.pending.find('\n', start)) != std::string::npos; start = end + 1)
+						stats.Merge(w.pending.substr(start, end - start), w.running);
+					w.pending.erase(0, start);
+					continue;
+				}
+				close(w.fd);
+				w.fd = -1;
+				--open;
+				int status = 0;
+				waitpid(w.pid, &status, 0);
+				if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+					continue;
+				const std::string how = WIFSIGNALED(status) ? "crashed (signal " + std::to_string(WTERMSIG(status)) + ")"
+				                                            : "exited with " + std::to_string(WEXITSTATUS(status));
+				if (w.running.empty()) {
+					out << "a worker process " << how << " between tests: its results are incomplete\n";
+				} else {
+					out << "a worker process " << how << " while running " << w.running << "\n";
+					stats.Crashed(w.running, how);
+				}
+			}
+		}
+		stats.Print(out);
+		return;
+	}
+#endif
+	RepeatSelection selection(seed, stats, repeat, untilFail);
+	runAll(selection, stats);
+	stats.Print(out);
+}
+
+#endif
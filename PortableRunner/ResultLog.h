@@ -0,0 +1,348 @@
+#ifndef TDD_RESULTLOG_H
+#define TDD_RESULTLOG_H
+
+// PortableRunner --log=<file>: appends a fixed-size binary record for each test to <file>; several runners (e.g., parallel
+// workers) can append to the same log at once. PortableRunner --query=<file> [--against=<file>] summarizes a log, and
+// lists the new failures and slowdowns in its latest run, compared with the latest run in the other log (or, without
+// --against, the run before it).
+//
+// File layout (native byte order): 128-byte records of two kinds, in any order:
+//     StringRecord: a group, test, file or message, identified by a hash of its text, and written once by each process
+//                   which uses it (in parts, if it's longer than one record holds)
+//     ResultRecord: one test's result, which refers to its strings by their hashes
+// A record is only ever appended whole, and a reader ignores a partial record at the end. If an append fails part way (e.g.,
+// the disk is full), the reporter says so, and logs nothing more, since a record after a partial one would be misaligned.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "..\shared\tdd.h"
+#include "MappedFile.h"
+
+namespace ResultLog
+{
+	enum Kind   : uint8_t { String = 'S', Result = 'R' };
+	enum Status : uint8_t { Passed = 0, Failed = 1 };
+
+	struct ResultRecord
+	{
+		uint8_t  kind;       // Result
+		uint8_t  status;
+		uint16_t reserved;
+		uint32_t line;       // of the first failure
+		uint64_t run;        // which run of the tests it's from
+		uint64_t group, test, file, message; // strings (0 => none)
+		uint64_t durationNs; // from the start of its TestInitialize to the end of its TestCleanup
+		uint64_t finishedMs; // since 1970
+		int64_t  counters[TDD::TestCounters::Count]; // -1 where they weren't measured (see --counters)
+	};
+	static_assert(sizeof(ResultRecord) == 128, "records are all 128 bytes");
+
+	struct StringRecord
+	{
+		enum { Capacity = 112 };
+		uint8_t  kind;  // String
+		uint8_t  part, parts;
+		uint8_t  length; // of this part
+		uint32_t reserved;
+		uint64_t id;
+		char     text[Capacity];
+	};
+	static_assert(sizeof(StringRecord) == 128, "records are all 128 bytes");
+
+	inline uint64_t Id(const char* s) // FNV-1a: the same in every process, so appenders needn't agree on ids
+	{
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (; *s; ++s)
+			h = (h ^ static_cast<unsigned char>(*s)) * 0x100000001b3ull;
+		return h == 0 ? 1 : h;
+	}
+}
+
+// passes everything on to another reporter, logging each test's result as it ends
+class ResultLogReporter : public TDD::Reporter
+{
+	struct Running
+	{
+		std::chrono::steady_clock::time_point started;
+		ResultLog::ResultRecord               record;
+	};
+	TDD::Reporter&                                         m_next;
+	const std::string                                      m_path;
+	AppendFile                                             m_file;
+	bool                                                   m_failed;   // an append didn't complete: stop logging
+	const uint64_t                                         m_run;
+	std::set<uint64_t>                                     m_interned; // strings this process has written
+	std::map<std::pair<const char*, const char*>, Running> m_running;  // (TEST_METHOD_ASYNCs overlap)
+	Running*                                               m_last;     // the test which started last
+
+	uint64_t Intern(const char* s, std::vector<char>& out)
+	{
+		if (!s || !*s)
+			return 0;
+		const uint64_t id = ResultLog::Id(s);
+		if (!m_interned.insert(id).second)
+			return id;
+		const size_t length = strlen(s), capacity = ResultLog::StringRecord::Capacity;
+		const size_t parts  = std::min<size_t>((length + capacity - 1) / capacity, 255); // a longer message is truncated
+		for (size_t p = 0; p < parts; ++p) {
+			ResultLog::StringRecord r;
+			memset(&r, 0, sizeof(r));
+			r.kind   = ResultLog::String;
+			r.part   = static_cast<uint8_t>(p);
+			r.parts  = static_cast<uint8_t>(parts);
+			r.length = static_cast<uint8_t>(std::min(capacity, length - p * capacity));
+			r.id     = id;
+			memcpy(r.text, s + p * capacity, r.length);
+			out.insert(out.end(), reinterpret_cast<const char*>(&r), reinterpret_cast<const char*>(&r) + sizeof(r));
+		}
+		return id;
+	}
+	void Write(ResultLog::ResultRecord& record, const char* group, const char* test)
+	{
+		std::vector<char> records; // its new strings, then the result, in one append
+		record.group = Intern(group, records);
+		record.test  = Intern(test,  records);
+		record.finishedMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+		records.insert(records.end(), reinterpret_cast<const char*>(&record), reinterpret_cast<const char*>(&record) + sizeof(record));
+		Append(records);
+	}
+	void Append(const std::vector<char>& records)
+	{
+		if (m_failed || records.empty())
+			return;
+		if (!m_file.Append(records.data(), records.size())) {
+			m_failed = true;
+			std::cout << m_path << "(0) : error : can't append to the result log (is the disk full?): logging stops here\n";
+		}
+	}
+	ResultLog::ResultRecord NewRecord() const
+	{
+		ResultLog::ResultRecord r;
+		memset(&r, 0, sizeof(r));
+		r.kind = ResultLog::Result;
+		r.run  = m_run;
+		for (int64_t& c : r.counters)
+			c = -1;
+		return r;
+	}
+	void Fail(ResultLog::ResultRecord& record, const TDD::TestFailure& tf, std::vector<char>& strings)
+	{
+		if (record.status == ResultLog::Failed)
+			return; // only the first failure is logged
+		record.status  = ResultLog::Failed;
+		record.line    = static_cast<uint32_t>(tf.line_number);
+		record.file    = Intern(tf.file_name, strings);
+		record.message = Intern(tf.error_string, strings);
+	}
+
+public:
+	ResultLogReporter(TDD::Reporter& next, const std::string& path, uint64_t run) : m_next(next), m_path(path), m_file(path), m_failed(false), m_run(run), m_last(nullptr) {}
+	bool IsOpen() const { return m_file.IsOpen(); }
+
+public: // TDD::Reporter
+	void ForEachTest(const TDD::UnitTestInfo& uti) override
+	{
+		Running& r = m_running[std::make_pair(uti.group, uti.testname)];
+		r.started = std::chrono::steady_clock::now();
+		r.record  = NewRecord();
+		m_last = &r;
+		m_next.ForEachTest(uti);
+	}
+	void ForEachFailure(const TDD::TestFailure& tf) override
+	{
+		std::vector<char> strings;
+		auto i = m_running.find(std::make_pair(tf.group, tf.testname));
+		if (i != m_running.end())
+			Fail(i->second.record, tf, strings);
+		else if (m_last) // e.g., its TestInitialize failed
+			Fail(m_last->record, tf, strings);
+		else { // e.g., TestClassCleanup: log it as a result of its own
+			ResultLog::ResultRecord record = NewRecord();
+			Fail(record, tf, strings);
+			Write(record, tf.group, tf.testname);
+		}
+		Append(strings);
+		m_next.ForEachFailure(tf);
+	}
+	void ForEachCounters(const TDD::UnitTestInfo& uti, const TDD::TestCounters& counters) override
+	{
+		auto i = m_running.find(std::make_pair(uti.group, uti.testname));
+		if (i != m_running.end())
+			for (int c = 0; c < TDD::TestCounters::Count; ++c)
+				i->second.record.counters[c] = counters.value[c];
+		m_next.ForEachCounters(uti, counters);
+	}
+	void ForEachTestEnd(const TDD::UnitTestInfo& uti) override
+	{
+		auto i = m_running.find(std::make_pair(uti.group, uti.testname));
+		if (i != m_running.end()) {
+			i->second.record.durationNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - i->second.started).count());
+			Write(i->second.record, uti.group, uti.testname);
+			if (m_last == &i->second)
+				m_last = nullptr;
+			m_running.erase(i);
+		}
+		m_next.ForEachTestEnd(uti);
+	}
+	void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { m_next.ForEachMessage(uti, message); }
+private:
+	ResultLogReporter& operator=(const ResultLogReporter&) = delete;
+};
+
+// reads a log in place, from a read-only mapping of it
+class ResultLogReader
+{
+	MappedFile                                  m_file;
+	std::unordered_map<uint64_t, std::string>   m_strings;
+	std::vector<const ResultLog::ResultRecord*> m_results;
+	std::vector<uint64_t>                       m_runs; // in the order they first appear
+	std::unordered_map<uint64_t, std::vector<const ResultLog::ResultRecord*>> m_byRun;
+
+public:
+	explicit ResultLogReader(const std::string& path) : m_file(path)
+	{
+		std::unordered_map<uint64_t, std::vector<std::string>> parts;
+		const size_t count = m_file.Size() / 128;
+		for (size_t i = 0; i < count; ++i) {
+			const char* record = m_file.Data() + i * 128;
+			if (record[0] == ResultLog::String) {
+				const ResultLog::StringRecord* s = reinterpret_cast<const ResultLog::StringRecord*>(record);
+				std::vector<std::string>& p = parts[s->id];
+				if (p.size() != s->parts)
+					p.assign(s->parts, std::string());
+				if (s->part < p.size())
+					p[s->part].assign(s->text, std::min<size_t>(s->length, ResultLog::StringRecord::Capacity));
+			} else if (record[0] == ResultLog::Result) {
+				const ResultLog::ResultRecord* r = reinterpret_cast<const ResultLog::ResultRecord*>(record);
+				m_results.push_back(r);
+				std::vector<const ResultLog::ResultRecord*>& run = m_byRun[r->run];
+				if (run.empty())
+					m_runs.push_back(r->run);
+				run.push_back(r);
+			}
+		}
+		for (const auto& p : parts) {
+			std::string& s = m_strings[p.first];
+			for (const auto& part : p.second)
+				s += part;
+		}
+	}
+
+	const std::vector<const ResultLog::ResultRecord*>& Results() const { return m_results; }
+	const std::vector<uint64_t>&                       Runs()    const { return m_runs; }
+	const std::vector<const ResultLog::ResultRecord*>& Results(uint64_t run) const // just that run's
+	{
+		static const std::vector<const ResultLog::ResultRecord*> none;
+		const auto i = m_byRun.find(run);
+		return i == m_byRun.end() ? none : i->second;
+	}
+
+	std::string String(uint64_t id) const
+	{
+		if (id == 0)
+			return std::string();
+		const auto i = m_strings.find(id);
+		return i == m_strings.end() ? std::string("<missing string>") : i->second;
+	}
+	std::string Name(const ResultLog::ResultRecord& r) const { return String(r.group) + "." + String(r.test); }
+
+private:
+	ResultLogReader(const ResultLogReader&) = delete;
+	ResultLogReader& operator=(const ResultLogReader&) = delete;
+};
+
+namespace ResultLog
+{
+	struct TestSummary // one test's results in one run (there's more than one result if it was repeated)
+	{
+		unsigned int          results = 0, failures = 0;
+		std::vector<uint64_t> durations;
+		const ResultRecord*   firstFailure = nullptr;
+		double MedianMs() { std::sort(durations.begin(), durations.end()); return durations.empty() ? 0 : durations[durations.size() / 2] / 1e6; }
+	};
+
+	inline std::map<std::string, TestSummary> Summarize(const ResultLogReader& log, uint64_t run)
+	{
+		std::map<std::string, TestSummary> tests;
+		for (const ResultRecord* r : log.Results(run)) {
+			TestSummary& t = tests[log.Name(*r)];
+			++t.results;
+			t.durations.push_back(r->durationNs);
+			if (r->status == Failed) {
+				++t.failures;
+				if (!t.firstFailure)
+					t.firstFailure = r;
+			}
+		}
+		return tests;
+	}
+
+	inline void PrintRuns(const ResultLogReader& log, std::ostream& out)
+	{
+		out << "run                   results  failures    total ms\n";
+		for (uint64_t run : log.Runs()) {
+			unsigned long long results = 0, failures = 0, ns = 0;
+			for (const ResultRecord* r : log.Results(run)) {
+				++results;
+				failures += r->status == Failed ? 1 : 0;
+				ns += r->durationNs;
+			}
+			out << std::left << std::setw(20) << run << std::right << std::setw(10) << results << std::setw(10) << failures
+			    << std::setw(12) << std::fixed << std::setprecision(1) << ns / 1e6 << "\n";
+		}
+		out.unsetf(std::ios::fixed);
+	}
+
+	// what's new in the "after" run: failures of tests which passed (or didn't run) before, and tests whose median duration grew by at least slowerMs
+	inline void PrintDiff(const ResultLogReader& beforeLog, uint64_t beforeRun, const ResultLogReader& afterLog, uint64_t afterRun, double slowerMs, std::ostream& out)
+	{
+		std::map<std::string, TestSummary> before = Summarize(beforeLog, beforeRun), after = Summarize(afterLog, afterRun);
+
+		unsigned int newFailures = 0, fixed = 0;
+		for (auto& a : after) {
+			const auto b = before.find(a.first);
+			if (a.second.failures != 0 && (b == before.end() || b->second.failures == 0)) {
+				const ResultRecord& f = *a.second.firstFailure;
+				out << "new failure: " << a.first << " - " << afterLog.String(f.file) << "(" << f.line << ") : \"" << afterLog.String(f.message) << "\"\n";
+				++newFailures;
+			}
+		}
+		for (auto& b : before) {
+			const auto a = after.find(b.first);
+			fixed += b.second.failures != 0 && a != after.end() && a->second.failures == 0 ? 1 : 0;
+		}
+
+		std::vector<std::pair<double, std::string>> slowdowns;
+		for (auto& a : after) {
+			auto b = before.find(a.first);
+			if (b == before.end())
+				continue;
+			const double was = b->second.MedianMs(), now = a.second.MedianMs();
+			if (now - was >= slowerMs) {
+				std::ostringstream s;
+				s << std::fixed << std::setprecision(1) << "slower by " << std::setw(8) << now - was << " ms: " << a.first << " (" << was << " ms -> " << now << " ms)";
+				slowdowns.emplace_back(now - was, s.str());
+			}
+		}
+		std::sort(slowdowns.begin(), slowdowns.end(), [](const std::pair<double, std::string>& x, const std::pair<double, std::string>& y) { return x.first > y.first; });
+		for (const auto& s : slowdowns)
+			out << s.second << "\n";
+
+		out << "run " << afterRun << " against run " << beforeRun << ": " << newFailures << " new failures, " << fixed << " fixed, "
+		    << slowdowns.size() << " tests slower by " << slowerMs << " ms or more\n";
+	}
+}
+
+#endif
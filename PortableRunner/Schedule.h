@@ -0,0 +1,159 @@
+#ifndef TDD_SCHEDULE_H
+#define TDD_SCHEDULE_H
+
+// Divides the tests into work items for the parallel modes (--coordinate and --repeat --jobs), longest first, so that
+// no long item is left to start last. An item is a whole test class, unless the class would take longer than the
+// workers' fair share of the run and its TestClassInitialize is cheap enough to repeat, in which case its methods are
+// split between several items (each of which runs TestClassInitialize again). Items of the same module (the runner,
+// or a test library) go to the workers which have already run that module's TEST_MODULE_INITIALIZE, where that's
+// cheaper than balancing them exactly.
+//
+// The durations come from a result log (--log): each test's latest. A class's first test includes its
+// TestClassInitialize (and a module's first test, its TEST_MODULE_INITIALIZE), so what it takes beyond the class's
+// other tests is taken to be the cost of repeating them. Tests the log doesn't know are expected to take as long as
+// the median test which it does.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "..\shared\tdd.h"
+#include "Bisect.h"
+#include "ResultLog.h"
+
+namespace Schedule
+{
+	struct Test
+	{
+		std::string module; // "" for the tests in the runner, or the path of a test library
+		std::string group, test;
+	};
+	struct Item
+	{
+		std::string              id;     // <module>|<group>, or <module>|<group>#<n> for part n of a class: unique, though groups needn't be
+		std::string              module;
+		std::string              group;
+		std::vector<std::string> tests;  // its methods, in the order they'd run
+		double                   ms;     // expected duration, including the class's setup
+		double                   moduleSetupMs; // expected duration of the module's setup, on a worker which hasn't run it yet
+	};
+
+	// each test's latest duration in a log, in ms
+	inline std::map<std::string, double> Durations(const std::string& log)
+	{
+		std::map<std::string, double> durations;
+		if (log.empty())
+			return durations;
+		ResultLogReader reader(log);
+		for (const ResultLog::ResultRecord* r : reader.Results()) // oldest first
+			durations[reader.Name(*r)] = static_cast<double>(r->durationNs) / 1e6;
+		return durations;
+	}
+
+	// adds a module's tests to tests, in the order they'd run
+	inline void List(const std::string& module, const Bisector::RunAll& run, std::vector<Test>& tests)
+	{
+		struct Null : TDD::Reporter { void ForEachFailure(const TDD::TestFailure&) override {} } null;
+		std::vector<std::string> names;
+		Selection list(0);
+		list.ListInstead(names);
+		run(list, null);
+		for (const auto& name : names) {
+			const size_t dot = name.rfind('.');
+			tests.push_back(Test{ module, name.substr(0, dot), name.substr(dot + 1) });
+		}
+	}
+
+	inline double Median(std::vector<double> v)
+	{
+		if (v.empty())
+			return 0;
+		std::sort(v.begin(), v.end());
+		return v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+	}
+
+	inline std::vector<Item> Plan(const std::vector<Test>& tests, const std::map<std::string, double>& durations, unsigned int workers)
+	{
+		std::vector<double> known;
+		for (const auto& d : durations)
+			known.push_back(d.second);
+		const double unknownMs = known.empty() ? 1 : Median(known);
+
+		struct Class { std::string module, group; std::vector<std::string> tests; std::vector<double> ms; double total, setupMs; };
+		std::vector<Class> classes;
+		double total = 0;
+		for (const Test& t : tests) {
+			if (classes.empty() || classes.back().group != t.group || classes.back().module != t.module)
+				classes.push_back(Class{ t.module, t.group, {}, {}, 0, 0 });
+			const auto d = durations.find(t.group + "." + t.test);
+			classes.back().tests.push_back(t.test);
+			classes.back().ms.push_back(d != durations.end() ? d->second : unknownMs);
+			classes.back().total += classes.back().ms.back();
+			total += classes.back().ms.back();
+		}
+		const double share = workers > 1 ? total / workers : total;
+		std::map<std::string, double> moduleSetupMs; // taken to be the setup of its first class, which includes it
+
+		std::vector<Item> items;
+		for (Class& c : classes) {
+			if (c.tests.size() > 1)
+				c.setupMs = std::max(0.0, c.ms[0] - Median(std::vector<double>(c.ms.begin() + 1, c.ms.end())));
+			moduleSetupMs.emplace(c.module, c.setupMs);
+
+			// k parts shorten the class's critical path by total*(1-1/k), and add (k-1) setups to the total work
+			size_t parts = 1;
+			if (workers > 1 && c.total > share && c.tests.size() > 1) {
+				parts = std::min<size_t>({ c.tests.size(), workers, static_cast<size_t>(std::ceil(c.total / share)) });
+				while (parts > 1 && c.setupMs * (parts - 1) > c.total * (1 - 1.0 / parts))
+					--parts;
+			}
+			const double perPart = (c.total - c.setupMs) / parts;
+			size_t next = 0;
+			for (size_t p = 0; p < parts; ++p) {
+				Item item{ c.module + "|" + c.group + (parts == 1 ? std::string() : "#" + std::to_string(p + 1)), c.module, c.group, {}, c.setupMs, 0 };
+				double ms = 0;
+				while (next < c.tests.size()) { // at least one test, and one left for each later part; the last part takes the rest
+					if (!item.tests.empty() && (c.tests.size() - next < parts - p || (p + 1 < parts && ms >= perPart)))
+						break;
+					ms += next == 0 ? c.ms[0] - c.setupMs : c.ms[next];
+					item.tests.push_back(c.tests[next++]);
+				}
+				item.ms += ms;
+				items.push_back(item);
+			}
+		}
+		for (Item& item : items)
+			item.moduleSetupMs = moduleSetupMs[item.module];
+		std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.ms > b.ms; });
+		return items;
+	}
+
+	// the items for each of a fixed number of workers (longest first, to the worker which would finish it soonest,
+	// counting the module's setup for a worker which hasn't run the module yet)
+	inline std::vector<std::vector<const Item*>> Partition(const std::vector<Item>& items, unsigned int workers)
+	{
+		std::vector<std::vector<const Item*>> partition(std::max(1u, workers));
+		std::vector<double> load(partition.size(), 0);
+		std::vector<std::set<std::string>> modules(partition.size());
+		for (const Item& item : items) {
+			size_t best = 0;
+			double bestFinish = 0;
+			for (size_t w = 0; w < partition.size(); ++w) {
+				const double finish = load[w] + item.ms + (modules[w].count(item.module) ? 0 : item.moduleSetupMs);
+				if (w == 0 || finish < bestFinish) {
+					best = w;
+					bestFinish = finish;
+				}
+			}
+			partition[best].push_back(&item);
+			load[best] = bestFinish;
+			modules[best].insert(item.module);
+		}
+		return partition;
+	}
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef TDD_SNAPSHOTSTORE_H
+#define TDD_SNAPSHOTSTORE_H
+
+// A TDD::SnapshotStore kept in one indexed file, which is memory-mapped so that
+// Assert::MatchesSnapshot compares against the mapped bytes without copying them.
+//
+// File layout (native byte order):
+//     char     magic[8];          "TDDSNAP1"
+//     uint64_t count;
+//     Entry    index[count];      sorted by key, for binary search
+//     char     blobs[];           keys and data, referred to by offset from the start of the file
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "..\shared\tdd.h"
+#include "MappedFile.h"
+
+class MappedSnapshotStore : public TDD::SnapshotStore
+{
+	struct Entry { uint64_t keyOffset, keySize, dataOffset, dataSize; };
+	static const char* Magic() { return "TDDSNAP1"; }
+
+	const std::string           m_path;
+	const bool                  m_updating;
+	std::unique_ptr<MappedFile> m_file;
+	const Entry*                m_index;
+	uint64_t                    m_count;
+
+	std::mutex                         m_mutex; // updates may come from several threads
+	std::map<std::string, std::string> m_updates;
+
+	// returns the index within a mapping, or nullptr if the file is empty, truncated or not a snapshot file
+	static const Entry* Index(const MappedFile& f, uint64_t& count)
+	{
+		count = 0;
+		const uint64_t header = 8 + sizeof(uint64_t);
+		if (f.Size() < header || memcmp(f.Data(), Magic(), 8) != 0)
+			return nullptr;
+		const uint64_t n = *reinterpret_cast<const uint64_t*>(f.Data() + 8);
+		if (n > (f.Size() - header) / sizeof(Entry))
+			return nullptr;
+		const Entry* index = reinterpret_cast<const Entry*>(f.Data() + header);
+		for (uint64_t i = 0; i < n; ++i)
+			if (index[i].keyOffset  > f.Size() || index[i].keySize  > f.Size() - index[i].keyOffset
+			 || index[i].dataOffset > f.Size() || index[i].dataSize > f.Size() - index[i].dataOffset)
+				return nullptr;
+		count = n;
+		return index;
+	}
+	static int Compare(const MappedFile& f, const Entry& e, const char* key, size_t keySize)
+	{
+		const size_t common = e.keySize < keySize ? static_cast<size_t>(e.keySize) : keySize;
+		const int c = memcmp(f.Data() + e.keyOffset, key, common);
+		return c != 0 ? c : (e.keySize < keySize ? -1 : (e.keySize > keySize ? 1 : 0));
+	}
+
+public:
+	MappedSnapshotStore(const std::string& path, bool updating)
+		: m_path(path)
+		, m_updating(updating)
+		, m_file(new MappedFile(path))
+	{
+		m_index = Index(*m_file, m_count);
+	}
+
+	bool Find(const char* key, const void*& data, unsigned long long& size) override
+	{
+		const size_t keySize = strlen(key);
+		uint64_t lo = 0, hi = m_count;
+		while (lo < hi)
+		{
+			const uint64_t mid = lo + (hi - lo) / 2;
+			const int c = Compare(*m_file, m_index[mid], key, keySize);
+			if (c == 0) {
+				data = m_file->Data() + m_index[mid].dataOffset;
+				size = m_index[mid].dataSize;
+				return true;
+			}
+			if (c < 0) lo = mid + 1;
+			else       hi = mid;
+		}
+		return false;
+	}
+	void Update(const char* key, const void* data, unsigned long long size) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_updates[key].assign(static_cast<const char*>(data), static_cast<size_t>(size));
+	}
+	bool Updating() const override { return m_updating; }
+
+	// Merges the updates into the file. Several runner processes may share a store, so this happens under an
+	// inter-process lock, re-reads the file in case another process has just saved, and replaces it atomically.
+	bool Save()
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_updates.empty())
+			return true;
+
+		FileLock lock(m_path + ".lock");
+		std::map<std::string, std::string> merged;
+		{
+			MappedFile current(m_path);
+			uint64_t count = 0;
+			const Entry* index = Index(current, count);
+			for (uint64_t i = 0; i < count; ++i)
+				merged[std::string(current.Data() + index[i].keyOffset, static_cast<size_t>(index[i].keySize))]
+					.assign(current.Data() + index[i].dataOffset, static_cast<size_t>(index[i].dataSize));
+		}
+		for (const auto& u : m_updates)
+			merged[u.first] = u.second;
+
+		const std::string temp = m_path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			const uint64_t count = merged.size();
+			out.write(Magic(), 8);
+			out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+			uint64_t offset = 8 + sizeof(count) + count * sizeof(Entry);
+			for (const auto& m : merged) {
+				const Entry e = { offset, m.first.size(), offset + m.first.size(), m.second.size() };
+				out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+				offset += m.first.size() + m.second.size();
+			}
+			for (const auto& m : merged) {
+				out.write(m.first .data(), static_cast<std::streamsize>(m.first .size()));
+				out.write(m.second.data(), static_cast<std::streamsize>(m.second.size()));
+			}
+			if (!out.flush())
+				return false;
+		}
+
+		m_file.reset(); // Windows can't replace a file which is mapped
+		m_index = nullptr;
+		m_count = 0;
+		std::error_code ec;
+		std::filesystem::rename(temp, m_path, ec);
+		m_file.reset(new MappedFile(m_path));
+		m_index = Index(*m_file, m_count);
+		if (!ec)
+			m_updates.clear();
+		return !ec;
+	}
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef TDD_TESTLIBRARY_H
+#define TDD_TESTLIBRARY_H
+
+// Test libraries: shared libraries (.so, .dylib or .dll) of tests built with TDD_TEST_LIBRARY defined (see tdd.h).
+// Running several in one process saves a link and a runner start-up per library.
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <dlfcn.h>
+#endif
+
+#include "..\shared\tdd.h"
+
+class TestLibrary
+{
+	const std::string m_path;
+	std::string       m_error;
+	void*             m_handle;
+	TDD::pfnRunTests  m_runTests;
+public:
+	explicit TestLibrary(const std::string& path) // loading runs the library's static initializers, i.e., registers its tests
+		: m_path(path)
+		, m_handle(nullptr)
+		, m_runTests(nullptr)
+	{
+#ifdef _WIN32
+		m_handle = LoadLibraryA(path.c_str());
+		if (!m_handle) {
+			m_error = "LoadLibrary failed with error " + std::to_string(GetLastError());
+			return;
+		}
+		m_runTests = reinterpret_cast<TDD::pfnRunTests>(reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(m_handle), "TddRunTests")));
+#else
+		const std::string p = path.find('/') == std::string::npos ? "./" + path : path; // don't search LD_LIBRARY_PATH for a file in the current directory
+		m_handle = dlopen(p.c_str(), RTLD_NOW | RTLD_LOCAL); // local: libraries mustn't see each other's symbols
+		if (!m_handle) {
+			const char* e = dlerror();
+			m_error = e ? e : "dlopen failed";
+			return;
+		}
+		m_runTests = reinterpret_cast<TDD::pfnRunTests>(dlsym(m_handle, "TddRunTests"));
+#endif
+		if (!m_runTests)
+			m_error = "no TddRunTests entry point: was it built with TDD_TEST_LIBRARY defined?";
+	}
+	~TestLibrary()
+	{
+#ifdef _WIN32
+		if (m_handle) FreeLibrary(static_cast<HMODULE>(m_handle));
+#else
+		if (m_handle) dlclose(m_handle);
+#endif
+	}
+
+	const std::string& Path () const { return m_path; }
+	const std::string& Error() const { return m_error; }
+	bool Loaded() const { return m_runTests != nullptr; }
+
+	void RunTests(TDD::Discriminator& d, TDD::Reporter& r, const TDD::LibraryHost& host) const { m_runTests(&d, &r, &host); }
+
+	// Loads the libraries on up to one thread per core, each taking the next library until there are none left, so
+	// that reading them and running their static initializers overlap as far as the OS loader allows. The results are
+	// in the same order as paths.
+	static std::vector<std::unique_ptr<TestLibrary>> LoadAll(const std::vector<std::string>& paths)
+	{
+		std::vector<std::unique_ptr<TestLibrary>> libraries(paths.size());
+		std::atomic<size_t> next(0);
+		const size_t threads = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<std::thread> loaders;
+		for (size_t t = 0; t < threads; ++t)
+			loaders.emplace_back([&libraries, &paths, &next]() {
+				for (size_t i; (i = next.fetch_add(1)) < paths.size(); )
+					libraries[i].reset(new TestLibrary(paths[i]));
+			});
+		for (auto& t : loaders)
+			t.join();
+		return libraries;
+	}
+
+private:
+	TestLibrary(const TestLibrary&) = delete;
+	TestLibrary& operator=(const TestLibrary&) = delete;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef TDD_TRACE_H
+#define TDD_TRACE_H
+
+// PortableRunner --trace[=<file>]: writes a timeline of the run (default trace.json) in the Chrome trace event format, for
+// https://ui.perfetto.dev or chrome://tracing. Each thread of each process gets a track of spans: each test's
+// TestModuleInitialize, TestClassInitialize, constructor, TestInitialize, test method, TestCleanup, TestClassCleanup and
+// TestModuleCleanup, and the spans which tests add with TDD_TRACE_SPAN("name").
+//
+// Recording a span only reads the clock and stores two events in its thread's buffer, the first with copies of its name
+// and class (so that neither has to outlive it: a name can be built as the test runs, and a class can be in a test library
+// which is unloaded, or a forked process which has exited, before the trace is written); nothing is formatted or written
+// until the run is over. The buffers are preallocated, in memory
+// shared with the processes which the runner forks (--jobs, --bisect, --fuzz), so their spans are in the timeline too,
+// each under its own pid. A thread's events beyond TDD_TRACE_MAX_EVENTS, and those of threads beyond
+// TDD_TRACE_MAX_THREADS, are counted, but not kept.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+ #include <process.h>
+#else
+ #include <pthread.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+
+#ifndef TDD_TRACE_MAX_THREADS
+ #define TDD_TRACE_MAX_THREADS 256
+#endif
+#ifndef TDD_TRACE_MAX_EVENTS
+ #define TDD_TRACE_MAX_EVENTS 16384 // for each thread: 2.25 MB (which is only committed as it's used)
+#endif
+#ifndef TDD_TRACE_MAX_NAME
+ #define TDD_TRACE_MAX_NAME 64 // bytes kept of a span's name, and of its class's, with the terminator (a longer one keeps its start and end)
+#endif
+
+class TraceRecorder : public TDD::Tracer
+{
+	enum Kind : uint64_t { SpanEnd, TestSpan, UserSpan }; // UserSpan: the span came from TDD_TRACE_SPAN
+	struct Event
+	{
+		uint64_t ns;   // since the run started
+		Kind     kind;
+		char     name [TDD_TRACE_MAX_NAME]; // (the end of a span has neither)
+		char     group[TDD_TRACE_MAX_NAME]; // "" for none
+	};
+	struct Buffer
+	{
+		uint32_t              pid;
+		uint32_t              count;
+		uint32_t              open;    // spans which began, and haven't ended
+		uint32_t              skipped; // of those, spans whose beginning didn't fit (so their ends aren't kept either)
+		std::atomic<uint64_t> dropped;
+		Event                 events[TDD_TRACE_MAX_EVENTS];
+	};
+	struct Shared
+	{
+		std::atomic<uint32_t> buffers;
+		std::atomic<uint64_t> dropped; // events of threads which didn't get a buffer
+		Buffer                buffer[TDD_TRACE_MAX_THREADS];
+	};
+	Shared*                                     m_shared;
+	const std::chrono::steady_clock::time_point m_start;
+	const uint32_t                              m_pid;
+
+	static uint32_t Pid()
+	{
+#ifdef _WIN32
+		return static_cast<uint32_t>(_getpid());
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+	static std::atomic<uint32_t>& Forks() // bumped in each forked child, where the threads' buffers are the parent's
+	{
+		static std::atomic<uint32_t> s_forks(0);
+		return s_forks;
+	}
+	Buffer* ThisThread() // its buffer, or 0 if there are none left
+	{
+		static thread_local Buffer*  t_buffer = nullptr;
+		static thread_local uint32_t t_forks = 0;
+		if (t_buffer && t_forks == Forks().load(std::memory_order_relaxed))
+			return t_buffer;
+		t_forks = Forks().load(std::memory_order_relaxed);
+		const uint32_t i = m_shared->buffers.fetch_add(1);
+		if (i >= TDD_TRACE_MAX_THREADS)
+			return t_buffer = nullptr;
+		t_buffer = &m_shared->buffer[i];
+		t_buffer->pid = Pid();
+		t_buffer->count = t_buffer->open = t_buffer->skipped = 0;
+		t_buffer->dropped = 0;
+		return t_buffer;
+	}
+	uint64_t Now() const { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count()); }
+
+	static void Quoted(std::string& out, const char* text)
+	{
+		out += '"';
+		for (const char* p = text; *p; ++p) {
+			const unsigned char c = static_cast<unsigned char>(*p);
+			if (c == '"' || c == '\\') {
+				out += '\\';
+				out += *p;
+			} else if (c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			} else {
+				out += *p;
+			}
+		}
+		out += '"';
+	}
+
+public:
+	TraceRecorder() : m_shared(nullptr), m_start(std::chrono::steady_clock::now()), m_pid(Pid())
+	{
+#ifdef _WIN32
+		m_shared = new Shared; // (no fork: only this process's threads use it)
+#else
+		void* p = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED)
+			m_shared = static_cast<Shared*>(p);
+		static bool s_registered = false;
+		if (!s_registered) {
+			s_registered = true;
+			pthread_atfork(nullptr, nullptr, []() { Forks().fetch_add(1); });
+		}
+#endif
+		if (m_shared) { // (a thread's buffer is cleared as it takes it)
+			m_shared->buffers = 0;
+			m_shared->dropped = 0;
+		}
+	}
+	~TraceRecorder()
+	{
+#ifdef _WIN32
+		delete m_shared;
+#else
+		if (m_shared)
+			munmap(m_shared, sizeof(Shared));
+#endif
+	}
+
+	// writes the events, once the run is over (and its forked processes have exited); false if it can't
+	bool Write(const std::string& path, std::ostream& out) const
+	{
+		if (!m_shared) {
+			out << "can't allocate the buffers for --trace\n";
+			return false;
+		}
+		const uint32_t buffers = std::min<uint32_t>(m_shared->buffers.load(), TDD_TRACE_MAX_THREADS);
+		uint64_t events = 0, dropped = m_shared->dropped.load();
+		std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		char line[128];
+		snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"PortableRunner\"}}", m_pid);
+		json += line;
+		for (uint32_t b = 0; b < buffers; ++b) {
+			const Buffer& buffer = m_shared->buffer[b];
+			dropped += buffer.dropped.load();
+			snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+			         buffer.pid, b + 1, buffer.pid == m_pid ? "thread" : "worker thread", b + 1);
+			json += line;
+			const Event* begun[TDD_TRACE_MAX_EVENTS / 2 + 1]; // the open spans, for the names of their ends
+			uint32_t depth = 0;
+			for (uint32_t e = 0; e < buffer.count; ++e) {
+				const Event& event = buffer.events[e];
+				if (event.kind == SpanEnd && depth == 0)
+					continue;
+				const Event& span = event.kind != SpanEnd ? event : *begun[depth - 1];
+				if (event.kind != SpanEnd)
+					begun[depth++] = &event;
+				else
+					--depth;
+				json += ",\n{\"name\":";
+				if (span.group[0] && span.kind == TestSpan) {
+					std::string name = span.group;
+					name += "::";
+					name += span.name;
+					Quoted(json, name.c_str());
+				} else {
+					Quoted(json, span.name);
+				}
+				snprintf(line, sizeof(line), ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%u,\"tid\":%u",
+				         span.kind == UserSpan ? "user" : "test", event.kind != SpanEnd ? 'B' : 'E', static_cast<unsigned long long>(event.ns / 1000), static_cast<unsigned long long>(event.ns % 1000), buffer.pid, b + 1);
+				json += line;
+				if (event.kind == UserSpan && span.group[0]) {
+					json += ",\"args\":{\"class\":";
+					Quoted(json, span.group);
+					json += '}';
+				}
+				json += '}';
+				++events;
+			}
+		}
+		json += "\n]}\n";
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(json.data(), static_cast<std::streamsize>(json.size()));
+		if (!file.flush()) {
+			out << "can't write the trace to " << path << "\n";
+			return false;
+		}
+		out << "wrote " << events << " trace events from " << buffers << " threads to " << path << " (open it in https://ui.perfetto.dev)\n";
+		if (dropped)
+			out << dropped << " trace events didn't fit in the buffers (TDD_TRACE_MAX_EVENTS for each thread, TDD_TRACE_MAX_THREADS)\n";
+		return true;
+	}
+
+public: // TDD::Tracer
+	void Begin(const char* name, const char* group) override
+	{
+		Buffer* buffer = m_shared ? ThisThread() : nullptr;
+		if (!buffer) {
+			if (m_shared)
+				m_shared->dropped.fetch_add(2, std::memory_order_relaxed);
+			return;
+		}
+		++buffer->open;
+		if (buffer->skipped || buffer->count + buffer->open + 1 > TDD_TRACE_MAX_EVENTS) { // (leaving room for the ends of the open spans)
+			++buffer->skipped;
+			buffer->dropped.fetch_add(2, std::memory_order_relaxed);
+			return;
+		}
+		Event& event = buffer->events[buffer->count++];
+		event.ns = Now();
+		event.kind = group ? TestSpan : UserSpan;
+		if (!group)
+			group = TDD::Verifier::CurrentTest() ? TDD::Verifier::CurrentTest()->group : "";
+		TDD::RecordedFailures::Copy(event.name,  TDD_TRACE_MAX_NAME, name,  (TDD_TRACE_MAX_NAME - 4) / 2);
+		TDD::RecordedFailures::Copy(event.group, TDD_TRACE_MAX_NAME, group, 0); // (the end of a class's name is its own)
+	}
+	void End() override
+	{
+		Buffer* buffer = m_shared ? ThisThread() : nullptr;
+		if (!buffer || buffer->open == 0)
+			return;
+		--buffer->open;
+		if (buffer->skipped) {
+			--buffer->skipped;
+			return;
+		}
+		Event& event = buffer->events[buffer->count++];
+		event.ns = Now();
+		event.kind = SpanEnd;
+	}
+
+private:
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+};
+
+#endif
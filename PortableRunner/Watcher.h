@@ -0,0 +1,258 @@
+#ifndef TDD_WATCHER_H
+#define TDD_WATCHER_H
+
+// PortableRunner --watch <test library> [--impact-map=<map>]: stays running, and every time the library is rebuilt,
+// reloads it and reruns the test classes which failed last time, or whose source files have changed since, or which are
+// new. A class's own source file isn't all it depends on, so when the library's contents have changed, it also reruns
+// the classes which the impact map (see Impact.h) says ran code from a file that has changed since; without a map, it
+// reruns them all. (Only files in the map count: a change to, say, a header of constants isn't spotted that way.)
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+ #include <poll.h>
+ #include <sys/inotify.h>
+ #include <unistd.h>
+#endif
+
+#include "..\shared\tdd.h"
+#include "Impact.h"
+#include "MappedFile.h"
+#include "PortableReporter.h"
+#include "TestLibrary.h"
+
+class FileWatcher // waits for a file to be rewritten
+{
+	const std::filesystem::path m_path;
+#ifdef __linux__
+	int m_inotify;
+
+	bool ReadEvents(int timeoutMs) // true if any of the events were for our file
+	{
+		pollfd p = { m_inotify, POLLIN, 0 };
+		if (poll(&p, 1, timeoutMs) <= 0)
+			return false;
+		alignas(inotify_event) char buffer[4096];
+		const ssize_t n = read(m_inotify, buffer, sizeof(buffer));
+		bool ours = false;
+		for (ssize_t i = 0; i < n; ) {
+			const inotify_event* e = reinterpret_cast<const inotify_event*>(buffer + i);
+			ours |= e->len != 0 && m_path.filename() == e->name;
+			i += static_cast<ssize_t>(sizeof(inotify_event) + e->len);
+		}
+		return ours;
+	}
+#else
+	std::filesystem::file_time_type m_lastWrite;
+
+	std::filesystem::file_time_type LastWrite() const
+	{
+		std::error_code ec;
+		return std::filesystem::last_write_time(m_path, ec);
+	}
+#endif
+public:
+	explicit FileWatcher(const std::filesystem::path& path) : m_path(path)
+	{
+#ifdef __linux__
+		// watch the directory, not the file: linkers often write a new file and rename it over the old one
+		const std::filesystem::path dir = m_path.has_parent_path() ? m_path.parent_path() : std::filesystem::path(".");
+		m_inotify = inotify_init1(IN_CLOEXEC);
+		if (m_inotify >= 0)
+			inotify_add_watch(m_inotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+#else
+		m_lastWrite = LastWrite();
+#endif
+	}
+	~FileWatcher()
+	{
+#ifdef __linux__
+		if (m_inotify >= 0)
+			close(m_inotify);
+#endif
+	}
+
+	// returns once the file has changed and then been left alone for a moment, since it's usually written in several steps
+	void WaitForChange()
+	{
+		const int quietMs = 200;
+#ifdef __linux__
+		while (!ReadEvents(-1)) {}
+		while (ReadEvents(quietMs)) {}
+#else
+		for (;;) { // no inotify: poll
+			std::this_thread::sleep_for(std::chrono::milliseconds(quietMs));
+			const auto w = LastWrite();
+			if (w != m_lastWrite) {
+				m_lastWrite = w;
+				break;
+			}
+		}
+		for (auto w = m_lastWrite; ; m_lastWrite = w) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(quietMs));
+			if ((w = LastWrite()) == m_lastWrite)
+				break;
+		}
+#endif
+	}
+private:
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+};
+
+class WatchMode
+{
+	struct ClassState
+	{
+		std::string file;     // where the test class is, for spotting edits
+		bool        failed;
+	};
+	const std::filesystem::path         m_path;
+	const TDD::LibraryHost&             m_host;
+	const std::string                   m_impactMap;
+	std::map<std::string, ClassState>   m_classes; // by group, i.e., class name
+	std::set<std::string>               m_rerun;
+	std::filesystem::file_time_type     m_lastRun;
+	uint64_t                            m_hash;
+	std::unique_ptr<TestLibrary>        m_library;
+	unsigned int                        m_generation;
+
+	struct Selection : TDD::Discriminator // classes to rerun, plus any we haven't seen before
+	{
+		const WatchMode& m_w;
+		explicit Selection(const WatchMode& w) : m_w(w) {}
+		bool WantTest(const TDD::UnitTestInfo& uti) override { return m_w.m_classes.count(uti.group) == 0 || m_w.m_rerun.count(uti.group) != 0; }
+	};
+	struct Recorder : TDD::Reporter // remembers each class's file and whether it failed, passing everything on
+	{
+		WatchMode&            m_w;
+		TDD::Reporter&        m_r;
+		std::set<std::string> m_seen;
+		Recorder(WatchMode& w, TDD::Reporter& r) : m_w(w), m_r(r) {}
+		void ForEachTest(const TDD::UnitTestInfo& uti) override
+		{
+			ClassState& c = m_w.m_classes[uti.group];
+			if (m_seen.insert(uti.group).second)
+				c = ClassState{ uti.class_file, false };
+			m_r.ForEachTest(uti);
+		}
+		void ForEachFailure(const TDD::TestFailure& tf) override
+		{
+			auto c = m_w.m_classes.find(tf.group);
+			if (c != m_w.m_classes.end())
+				c->second.failed = true;
+			m_r.ForEachFailure(tf);
+		}
+		void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message) override { m_r.ForEachMessage(uti, message); }
+	};
+
+	static uint64_t Hash(const std::filesystem::path& path) { return HashContents(MappedFile(path.string())); }
+	bool Reload()
+	{
+		// load a copy: the original stays free for the linker to overwrite (Windows won't allow that for a loaded .dll),
+		// and a fresh path guarantees a fresh image (a library with unique symbols can't really be unloaded)
+		m_library.reset();
+		const std::filesystem::path copy = std::filesystem::temp_directory_path()
+			/ ("tdd-watch-" + std::to_string(++m_generation) + "-" + m_path.filename().string());
+		std::error_code ec;
+		std::filesystem::copy_file(m_path, copy, std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec) {
+			std::cout << m_path.string() << "(0) : warning : can't copy test library : \"" << ec.message() << "\"\n";
+			return false;
+		}
+		m_library.reset(new TestLibrary(copy.string()));
+		std::filesystem::remove(copy, ec); // the loaded image stays valid (except on Windows, where this fails harmlessly)
+		if (!m_library->Loaded()) {
+			std::cout << m_path.string() << "(0) : warning : can't load test library : \"" << m_library->Error() << "\"\n";
+			m_library.reset();
+			return false;
+		}
+		return true;
+	}
+	bool Changed(const ClassState& c) const
+	{
+		std::error_code ec;
+		const auto t = std::filesystem::last_write_time(c.file, ec);
+		return c.file.empty() || ec || t > m_lastRun; // if we can't tell, assume it has
+	}
+	// adds the classes which may run code that has changed since the last run; false if that might be any of them
+	bool Impacted(std::set<std::string>& classes) const
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(m_impactMap, ec))
+			return false;
+		ImpactMap map(m_impactMap);
+		if (!map.Valid())
+			return false;
+		std::vector<std::string> changed;
+		for (const auto& f : map.Files()) {
+			const auto t = std::filesystem::last_write_time(f, ec);
+			if (ec || t > m_lastRun)
+				changed.push_back(f);
+		}
+		std::set<std::string> impacted; // tests (<group>.<test>) and classes (<group>)
+		std::string unknown;
+		if (!map.Impacted(changed, impacted, unknown))
+			return false;
+		for (const auto& name : impacted)
+			classes.insert(name.substr(0, name.find('.')));
+		return true;
+	}
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		m_lastRun = std::filesystem::file_time_type::clock::now();
+		{
+			PortableReporter reporter;
+			Recorder recorder(*this, reporter);
+			Selection selection(*this);
+			m_library->RunTests(selection, recorder, m_host);
+		}
+		std::cout << "(" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms) watching " << m_path.string() << "..." << std::endl;
+	}
+
+public:
+	WatchMode(const std::string& path, const TDD::LibraryHost& host, const std::string& impactMap)
+		: m_path(path), m_host(host), m_impactMap(impactMap), m_hash(0), m_generation(0) {}
+
+	void RunForever()
+	{
+		FileWatcher watcher(m_path);
+		m_hash = Hash(m_path);
+		if (Reload())
+			Run(); // everything, the first time
+
+		for (;;)
+		{
+			watcher.WaitForChange();
+			const uint64_t hash = Hash(m_path);
+			const bool rebuilt = hash != m_hash;
+			if (rebuilt || !m_library) { // an identical rebuild keeps the library loaded (and RunTests reinitializes its module)
+				m_hash = hash;
+				if (!Reload())
+					continue;
+			}
+			m_rerun.clear();
+			if (rebuilt && !Impacted(m_rerun)) {
+				for (const auto& c : m_classes)
+					m_rerun.insert(c.first);
+			}
+			for (const auto& c : m_classes)
+				if (c.second.failed || Changed(c.second))
+					m_rerun.insert(c.first);
+			std::cout << "\n" << m_path.filename().string() << " rebuilt: rerunning " << m_rerun.size() << " of " << m_classes.size() << " test classes, plus any new ones\n";
+			Run();
+		}
+	}
+};
+
+#endif
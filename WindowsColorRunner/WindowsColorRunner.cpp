@@ -44,6 +44,10 @@ public: // TDD::Reporter
         std::cout << "Failure in " << tr.group << "." << tr.testname << " - \n";
         std::cout << tr.file_name << "(" << tr.line_number << ") : warning : Assertion Failure : " << tr.error_string << "\n";
     }
+    virtual void ForEachMessage(const TDD::UnitTestInfo& uti, const char* message)
+    {
+        std::cout << "Message from " << uti.group << "." << uti.testname << " - " << message << "\n";
+    }
 private:
     ResultReporter& operator=(const ResultReporter&) = delete;
 };
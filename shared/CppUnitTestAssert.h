@@ -4,11 +4,15 @@
 // portable drop-in replacement for VS's Assert class
 
 #include <cstdlib>   // for std::abs
-#include <algorithm> // for std::transform
+#include <algorithm> // for std::transform, std::mismatch
+#include <chrono>
+#include <string_view>
 #include <source_location> // C++20+ only
 
 #include "tddAssertStl.h"
+#include "tddTiming.h"
 
+TDD_LIBRARY_LOCAL_BEGIN
 namespace Microsoft { namespace VisualStudio { namespace CppUnitTestFramework
 {
 namespace Details
@@ -20,23 +24,76 @@ namespace Details
 		return in;
 	}
 	inline void ToLower(std::string& s) { std::transform(s.begin(), s.end(), s.begin(), tolower); }
+
+	// where two snapshots first differ, with (at most) a line of each around that point, so that huge outputs give short messages
+	inline std::string SnapshotDiff(std::string_view expected, std::string_view actual)
+	{
+		const size_t common = expected.size() < actual.size() ? expected.size() : actual.size();
+		const size_t at     = std::mismatch(expected.begin(), expected.begin() + common, actual.begin()).first - expected.begin();
+		const size_t line   = 1 + std::count(expected.begin(), expected.begin() + at, '\n');
+
+		auto Excerpt = [at](std::string_view s)
+		{
+			const size_t maxBefore = 40, maxLength = 80;
+			size_t begin = at == 0 ? std::string_view::npos : s.rfind('\n', at - 1);
+			begin = begin == std::string_view::npos ? 0 : begin + 1;
+			if (at - begin > maxBefore)
+				begin = at - maxBefore;
+			size_t end = at < s.size() ? s.find('\n', at + 1) : std::string_view::npos;
+			if (end == std::string_view::npos || end - begin > maxLength)
+				end = begin + maxLength < s.size() ? begin + maxLength : s.size();
+
+			static const char hex[] = "0123456789abcdef";
+			std::string e;
+			for (size_t i = begin; i < end; ++i)
+			{
+				const unsigned char c = static_cast<unsigned char>(s[i]);
+				if      (c == '\\') e += "\\\\";
+				else if (c == '\n') e += "\\n";
+				else if (c == '\t') e += "\\t";
+				else if (c == '\r') e += "\\r";
+				else if (c >= ' ' && c < 0x7f) e += char(c);
+				else { e += "\\x"; e += hex[c >> 4]; e += hex[c & 15]; }
+			}
+			return e;
+		};
+		return "first difference at byte " + std::to_string(at) + " (line " + std::to_string(line) + "); sizes " + std::to_string(expected.size()) + " and " + std::to_string(actual.size())
+		     + "; expected <" + Excerpt(expected) + "> actual <" + Excerpt(actual) + ">";
+	}
 }
 
-struct Assert
+template <TDD::FailureAction action> struct BasicAssert
 {
+	static TDD::AssertT<std::string> At(const std::source_location& loc) { return TDD::AssertT<std::string>(loc.line(), loc.file_name(), action); }
+
 	template<typename T> static void AreEqual(const T& expected, const T& actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual(expected, actual, message);
+		At(loc).AreEqual(expected, actual, message);
 	}
 	static void AreEqual(double expected, double actual, double tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (std::abs(expected - actual) > std::abs(tolerance))
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual(expected, actual, message);
+			At(loc).AreEqual(expected, actual, message);
 	}
 	static void AreEqual(float expected, float actual, float tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if(std::abs(expected - actual) > std::abs(tolerance))
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual(expected, actual, message);
+			At(loc).AreEqual(expected, actual, message);
+	}
+	// element-wise comparison of whole arrays: reports the number of failures and the worst element, rather than stopping at the first
+	static void AreEqual(const double* expected, const double* actual, size_t count, const TDD::Tolerance& tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		At(loc).IsWithin(expected, actual, count, tolerance, message);
+	}
+	static void AreEqual(const float* expected, const float* actual, size_t count, const TDD::Tolerance& tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		At(loc).IsWithin(expected, actual, count, tolerance, message);
+	}
+	template<typename C> static void AreEqual(const C& expected, const C& actual, const TDD::Tolerance& tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{   // C is any contiguous container of floats or doubles, e.g. std::vector<double>
+		if (expected.size() != actual.size())
+			return At(loc).AreEqual(expected.size(), actual.size(), std::wstring(L"array sizes differ - ") + message);
+		At(loc).IsWithin(expected.data(), actual.data(), expected.size(), tolerance, message);
 	}
 	static void AreEqual(const char* expected, const char* actual, bool ignoreCase = false, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
@@ -48,7 +105,7 @@ struct Assert
 			if (expectedLower.compare(actualLower) == 0)
 				return;
 		}
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual(expected, actual, message);
+		At(loc).AreEqual(expected, actual, message);
 	}
 	static void AreEqual(const wchar_t* expected, const wchar_t* actual, bool ignoreCase = false, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
@@ -60,29 +117,29 @@ struct Assert
 			if (expectedLower.compare(actualLower) == 0)
 				return;
 		}
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual(expected, actual, message);
+		At(loc).AreEqual(expected, actual, message);
 	}
 	template<typename T> static void AreSame(T* expected, T* actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual((const void*)expected, (const void*)actual, message);
+		At(loc).AreEqual((const void*)expected, (const void*)actual, message);
 	}
 	template<typename T> static void AreSame(const T& expected, const T& actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreEqual((const void*)&expected, (const void*)&actual, message);
+		At(loc).AreEqual((const void*)&expected, (const void*)&actual, message);
 	}
 	template<typename T> static void AreNotEqual(const T& notExpected, const T& actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual(notExpected, actual, message);
+		At(loc).AreNotEqual(notExpected, actual, message);
 	}
 	static void AreNotEqual(double notExpected, double actual, double tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (std::abs(notExpected - actual) <= std::abs(tolerance))
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual(actual, actual, std::wstring(message));
+			At(loc).AreNotEqual(actual, actual, std::wstring(message));
 	}
 	static void AreNotEqual(float notExpected, float actual, float tolerance, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (std::abs(notExpected - actual) <= std::abs(tolerance))
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual(actual, actual, std::wstring(message));
+			At(loc).AreNotEqual(actual, actual, std::wstring(message));
 	}
 	static void AreNotEqual(const char* notExpected, const char* actual, bool ignoreCase = false, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
@@ -92,7 +149,7 @@ struct Assert
 			Details::ToLower(csExpected);
 			Details::ToLower(csActual);
 		}
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual(csExpected, csActual, message);
+		At(loc).AreNotEqual(csExpected, csActual, message);
 	}
 	static void AreNotEqual(const wchar_t* notExpected, const wchar_t* actual, bool ignoreCase = false, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
@@ -102,53 +159,114 @@ struct Assert
 			Details::ToLower(csExpected);
 			Details::ToLower(csActual);
 		}
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual(csExpected, csActual, message);
+		At(loc).AreNotEqual(csExpected, csActual, message);
 	}
 	template<typename T> static void AreNotSame(T* notExpected, T* actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual((const void*)notExpected, (const void*)actual, message);
+		At(loc).AreNotEqual((const void*)notExpected, (const void*)actual, message);
 	}
 	template<typename T> static void AreNotSame(const T& notExpected, const T& actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).AreNotEqual((const void*)&notExpected, (const void*)&actual, message);
+		At(loc).AreNotEqual((const void*)&notExpected, (const void*)&actual, message);
 	}
 	template<typename T> static void IsNull(const T* actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (!!actual)
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail(message);
+			At(loc).Fail(message);
 	}
 	template<typename T> static void IsNotNull(const T* actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (!actual)
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail(message);
+			At(loc).Fail(message);
 	}
 	static void IsTrue(bool condition, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (!condition)
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail(message);
+			At(loc).Fail(message);
 	}
 	static void IsFalse(bool condition, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (condition)
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail(message);
+			At(loc).Fail(message);
 	}
 	static void Fail(const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
 		if (message == NULL)
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail("");
+			At(loc).Fail("");
 		else
-			TDD::AssertT<std::string>(loc.line(), loc.file_name()).Fail(message);
+			At(loc).Fail(message);
+	}
+	// compares actual against the snapshot stored under "<group>.<testname>.<name>" by the runner (rewrite them with PortableRunner --update-snapshots)
+	static void MatchesSnapshot(const char* name, std::string_view actual, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		const std::string suffix = (message && *message) ? " - " + TDD::Details::FromWide(message) : std::string();
+		TDD::SnapshotStore* store = TDD::SnapshotStore::Current();
+		if (!store)
+			return At(loc).Fail("no snapshot store: the test runner doesn't support snapshots" + suffix);
+
+		const TDD::UnitTestInfo* uti = TDD::Verifier::CurrentTest();
+		const std::string key = std::string(uti ? uti->group : "") + "." + (uti ? uti->testname : "") + "." + name;
+		if (store->Updating())
+			return store->Update(key.c_str(), actual.data(), actual.size());
+
+		const void* data = nullptr;
+		unsigned long long size = 0;
+		if (!store->Find(key.c_str(), data, size))
+			return At(loc).Fail("no snapshot <" + key + ">: run with --update-snapshots to create it" + suffix);
+
+		const std::string_view expected(static_cast<const char*>(data), static_cast<size_t>(size)); // no copy: these are the store's mapped bytes
+		if (expected != actual)
+			At(loc).Fail("snapshot <" + key + "> differs: " + Details::SnapshotDiff(expected, actual) + suffix);
+	}
+	static void MatchesSnapshot(const char* name, const void* actual, size_t size, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		MatchesSnapshot(name, std::string_view(static_cast<const char*>(actual), size), message, loc);
+	}
+	// fails if the median time f() takes is over limit (see tddTiming.h for how it's measured)
+	template<class Rep, class Period, class F> static void CompletesWithin(std::chrono::duration<Rep, Period> limit, F&& f, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		const double limitNs = std::chrono::duration<double, std::nano>(limit).count();
+		TDD::Timing::Measurement m;
+		if (TDD::Timing::Exceeds(f, limitNs, m))
+			At(loc).Fail("took longer than " + TDD::Timing::Format(limitNs) + ": " + TDD::Timing::Describe(m) + ((message && *message) ? " - " + TDD::Details::FromWide(message) : std::string()));
+	}
+	// fails if the median time f() takes is more than tolerance (e.g. 0.1 => 10%) over the baseline stored under "<group>.<testname>.<name>"
+	// by the runner (record baselines with PortableRunner --record-baselines, on the machine which runs the tests)
+	template<class F> static void NoSlowerThanBaseline(const char* name, F&& f, double tolerance = 0.1, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
+	{
+		const std::string suffix = (message && *message) ? " - " + TDD::Details::FromWide(message) : std::string();
+		TDD::BaselineStore* store = TDD::BaselineStore::Current();
+		if (!store)
+			return At(loc).Fail("no baseline store: the test runner doesn't support baselines" + suffix);
+
+		const TDD::UnitTestInfo* uti = TDD::Verifier::CurrentTest();
+		const std::string key = std::string(uti ? uti->group : "") + "." + (uti ? uti->testname : "") + "." + name;
+		if (store->Recording())
+			return store->Update(key.c_str(), TDD::Timing::Measure(f).median);
+
+		double baseline = 0;
+		if (!store->Find(key.c_str(), baseline))
+			return At(loc).Fail("no baseline <" + key + ">: run with --record-baselines to record it" + suffix);
+
+		TDD::Timing::Measurement m;
+		if (TDD::Timing::Exceeds(f, baseline * (1 + tolerance), m))
+			At(loc).Fail("<" + key + "> is " + std::to_string(static_cast<int>((m.median / baseline - 1) * 100 + 0.5)) + "% slower than its baseline of "
+			             + TDD::Timing::Format(baseline) + " (tolerance " + std::to_string(static_cast<int>(tolerance * 100 + 0.5)) + "%): " + TDD::Timing::Describe(m) + suffix);
 	}
 	template<typename _EXPECTEDEXCEPTION, typename _FUNCTOR> static void ExpectException(_FUNCTOR functor, const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).ExpectingException<_EXPECTEDEXCEPTION, _FUNCTOR>(functor, message);
+		At(loc).ExpectingException<_EXPECTEDEXCEPTION, _FUNCTOR>(functor, message);
 	}
 	template<typename _EXPECTEDEXCEPTION, typename _RETURNTYPE> static void ExpectException(_RETURNTYPE (*func)(), const wchar_t* message = L"", const std::source_location& loc = std::source_location::current())
 	{
-		TDD::AssertT<std::string>(loc.line(), loc.file_name()).ExpectingException<_EXPECTEDEXCEPTION,_RETURNTYPE (*)()>(func, message);
+		At(loc).ExpectingException<_EXPECTEDEXCEPTION,_RETURNTYPE (*)()>(func, message);
 	}
 };
 
+typedef BasicAssert<TDD::ThrowOnFailure>    Assert; // a failure throws, ending the test
+typedef BasicAssert<TDD::RecordAndContinue> Expect; // a failure is recorded, and the test carries on; all are reported when the test ends
+
 }}}
+TDD_LIBRARY_LOCAL_END
 
 #endif // MS_CPP_UNITTESTFRAMEWORK_ASSERT
\ No newline at end of file
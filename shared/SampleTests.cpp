@@ -1,4 +1,8 @@
 #include "..\shared\CppUnitTest.h"
+#include "..\shared\tddAsync.h"
+#include "..\shared\tddMock.h"
+#include "..\shared\tddStress.h"
+#include "..\shared\tddThreads.h"
 
 /*
     If you cannot use exceptions (e.g., for kernel mode tests), define:
@@ -57,3 +61,125 @@ namespace IfYouLikeFluentAssertions
         }
     };
 }
+
+namespace IfYourCodeIsConstexpr
+{
+    constexpr int Square(int n) { return n * n; }
+
+    TEST_CLASS(SomeClass)
+    {
+        TEST_CONSTEXPR(ACompileTimeTest) // passes; if it didn't, this file wouldn't compile
+        {
+            int sum = 0;
+            for (int i = 1; i <= 3; ++i)
+                sum += Square(i);
+            TDD_CONSTEXPR_VERIFY_EQUAL(14, sum);
+        }
+    };
+}
+
+namespace IfYourCodeCallsAnInterface
+{
+    using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+    struct IStore
+    {
+        virtual ~IStore() {}
+        virtual bool Put(int key, const std::string& value) = 0;
+        virtual int  Get(int key) const = 0;
+    };
+    struct MockStore : IStore
+    {
+        TDD_MOCK_METHOD2(bool, Put, int, const std::string&);
+        TDD_MOCK_CONST_METHOD1(int, Get, int);
+    };
+    inline void Copy(IStore& store, int from, int to) { store.Put(to, std::to_string(store.Get(from))); }
+
+    TEST_CLASS(SomeClass)
+    {
+        TEST_METHOD(AMockedTest)
+        {
+            MockStore store;
+            TDD_EXPECT_CALL(store, Get).With(1).Returns(42);
+            TDD_EXPECT_CALL(store, Put).With(TDD::Gt(1), TDD::Any()).Returns(true);
+            Copy(store, 1, 2); // passes
+            Assert::AreEqual(std::string("42"), std::get<1>(store.Put_mock.Call(0)));
+        }
+        TEST_METHOD(AnotherMockedTest)
+        {
+            MockStore store;
+            TDD_EXPECT_CALL(store, Put).Times(2).Returns(true);
+            Copy(store, 1, 2); // fails as the test finishes, since Put was called only once
+        }
+    };
+}
+
+namespace IfYourCodeTakesAnyInput
+{
+    using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+    inline size_t Parse(const uint8_t* data, size_t size) // a length, then that many bytes; returns how many it read
+    {
+        return size == 0 || data[0] >= size ? 0 : 1 + data[0];
+    }
+
+    TEST_CLASS(SomeClass)
+    {
+        TEST_FUZZ(AFuzzTarget)(const uint8_t* data, size_t size) // passes, whatever the input
+        {
+            Assert::IsTrue(Parse(data, size) <= size);
+        }
+    };
+}
+
+namespace IfYourCodeIsAsynchronous
+{
+    using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+    TEST_CLASS(SomeClass)
+    {
+        TEST_METHOD_ASYNC(AWaitingTest)
+        {
+            std::future<int> answer = std::async(std::launch::async, []() { return 42; });
+            co_await TDD::Async::Delay(std::chrono::milliseconds(1));
+            Assert::AreEqual(42, co_await TDD::Async::Ready(answer)); // passes, once the answer is ready
+        }
+        TEST_METHOD_ASYNC(AnotherWaitingTest)
+        {
+            co_await TDD::Async::Delay(std::chrono::milliseconds(1));
+            Assert::AreEqual(1, 2, L"not even after waiting");
+        }
+    };
+}
+
+namespace IfYourCodeMustBeThreadSafe
+{
+    TEST_CLASS(SomeClass)
+    {
+        std::atomic<unsigned int> m_count{ 0 };
+
+        TEST_STRESS(AStressTest, 4, 1000) // 4 threads, 1000 times each; passes
+        {
+            TddAssert().IsTrue(++m_count <= 4000u);
+        }
+        TEST_STRESS(ACollidingStressTest, 4, 1000, TDD::Stress::Options().RandomYields(16))
+        {
+            TddAssert().IsTrue(thread.iteration < 500, "stops all the threads, halfway through");
+        }
+    };
+}
+
+namespace IfYourTestStartsThreads
+{
+    using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+    TEST_CLASS(SomeClass)
+    {
+        TEST_METHOD(AFailureOnAnotherThread)
+        {
+            auto work = TDD::TestContext::Capture().Wrap([](int n) { Expect::AreEqual(3, n); }); // for an executor to run
+            std::thread(work, 3).join(); // passes
+            TDD::TestThread helper([]() { Assert::AreEqual(1, 2, L"not on a helper thread either"); }); // reported with this test
+        }
+    };
+}
@@ -7,6 +7,7 @@
 
 #include "tddAssertBase.h"
 
+TDD_LIBRARY_LOCAL_BEGIN
 namespace TDD
 {
 	template <> inline bool         IsEmpty(const std::string& s) { return s.empty(); }
@@ -84,7 +85,9 @@ namespace TDD
 	template <> inline std::string ToString<std::string,  char  > (const  char  * t) { return std::string(t); }
 	template <> inline std::string ToString<std::string, wchar_t> (const wchar_t* t) { return Details::FromWide(t); }
 }
+TDD_LIBRARY_LOCAL_END
 
 #define TddAssert(...) TDD::AssertT<std::string>(__LINE__, __FILE__)
+#define TddExpect(...) TDD::AssertT<std::string>(__LINE__, __FILE__, TDD::RecordAndContinue) // failures are reported when the test ends, and the test carries on
 
 #endif
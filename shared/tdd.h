@@ -75,14 +75,62 @@ TEST_CLASS(SomeClass) // or TESTCLASS(SomeClass)
  #endif
 #endif
 
+// Tests built as a shared library (.so, .dylib or .dll) for PortableRunner to load: #define TDD_TEST_LIBRARY for the whole library.
+// Each library then keeps its own TDD statics (test table, etc.), even when several are loaded into one process,
+// and exports a single entry point, TddRunTests (see the end of this file).
+// (gcc and clang would otherwise merge the function-local statics of identical inline functions across libraries.)
+// Everything else the TDD headers define is hidden too (between TDD_LIBRARY_LOCAL_BEGIN and TDD_LIBRARY_LOCAL_END), so
+// that a runner linked with -rdynamic, which has its own copies of the same inline functions, can't interpose them.
+#if defined(TDD_TEST_LIBRARY) && defined(__GNUC__)
+ #define TDD_LIBRARY_LOCAL __attribute__((visibility("hidden")))
+ #define TDD_LIBRARY_LOCAL_BEGIN _Pragma("GCC visibility push(hidden)")
+ #define TDD_LIBRARY_LOCAL_END   _Pragma("GCC visibility pop")
+#else
+ #define TDD_LIBRARY_LOCAL
+ #define TDD_LIBRARY_LOCAL_BEGIN
+ #define TDD_LIBRARY_LOCAL_END
+#endif
+
+// Verifier keeps one per-thread pointer, so that threads a test starts can report failures (see tddThreads.h). It's only
+// thread_local where the compiler says there are threads (__STDCPP_THREADS__, or _MT for MSVC's runtime libraries) and it
+// isn't kernel mode (_KERNEL_MODE, __KERNEL__), which has no thread-local storage; #define TDD_THREAD_LOCAL_STORAGE or
+// TDD_NO_THREAD_LOCAL to decide otherwise. Without it, tddThreads.h can't be used.
+#if defined(TDD_NO_THREAD_LOCAL)
+ #define TDD_THREAD_LOCAL
+#elif defined(TDD_THREAD_LOCAL_STORAGE) || ((defined(__STDCPP_THREADS__) || defined(_MT)) && !defined(_KERNEL_MODE) && !defined(__KERNEL__))
+ #define TDD_THREAD_LOCAL thread_local
+ #define TDD_HAS_THREAD_LOCAL
+#else
+ #define TDD_THREAD_LOCAL
+#endif
+
+// #define TDD_NO_HEAP to run without dynamic allocation (e.g., in kernel mode, or where the allocator's jitter would upset
+// timing-sensitive tests): each test class's registrar, each test method's TestMethodInfo, each test class's instance
+// (one at a time) and each TDD_CACHED_FIXTURE are then constructed in static buffers sized at compile time, rather than
+// with new. Then tddAsync.h can't be used (a waiting test needs an instance of its own), and a class's tests mustn't be
+// run again from one of its own tests.
+
+// Test class names (with their namespaces) are worked out at compile time where constexpr allows loops (C++14), and at
+// static-initialization time otherwise.
+#if !defined(TDD_NO_CONSTEXPR_NAMES) && (__cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L))
+ #define TDD_CONSTEXPR_NAMES
+#endif
+// TEST_CONSTEXPR bodies are checked by the compiler where a constexpr function can have statements (C++14), and run as
+// ordinary tests otherwise.
+#if !defined(TDD_NO_CONSTEXPR_TESTS) && (__cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L))
+ #define TDD_CONSTEXPR_TESTS
+#endif
+
+TDD_LIBRARY_LOCAL_BEGIN
 namespace TDD
 {
 
 struct UnitTestInfo // a container to hold some info about each test
 {
-    UnitTestInfo(_In_z_ const char* g, _In_z_ const char* t) : group(g), testname(t) {}
-    UnitTestInfo(_In_ const UnitTestInfo* uti) : group(uti->group), testname(uti->testname) {}
+    UnitTestInfo(_In_z_ const char* g, _In_z_ const char* t, _In_z_ const char* f = "") : group(g), testname(t), class_file(f) {}
+    UnitTestInfo(_In_ const UnitTestInfo* uti) : group(uti->group), testname(uti->testname), class_file(uti->class_file) {}
     const char *group, *testname;
+    const char *class_file; // the source file of the test class (__FILE__), or "" if unknown
 };
 
 struct TestFailure : public UnitTestInfo // a container to hold some info about a test failure
@@ -97,15 +145,31 @@ struct TestFailure : public UnitTestInfo // a container to hold some info about
     unsigned long line_number;
 };
 
+// What a TestInstrument (see below) measured while a test method ran. A counter which couldn't be read is -1.
+struct TestCounters
+{
+    enum Counter { Instructions, Cycles, CacheMisses, BranchMisses, // from the CPU, if it lets us
+                   CpuTimeNs, PageFaults, ContextSwitches, MaxRssGrowthKb, Count };
+    long long value[Count];
+    TestCounters() { for (int i = 0; i < Count; ++i) value[i] = -1; }
+};
+
 struct Reporter
 {
     virtual void ForEachTest   (const UnitTestInfo&) {}  // called once for each test
     virtual void ForEachFailure(const TestFailure&) = 0;  // called once for each failure
+    virtual void ForEachTestEnd(const UnitTestInfo&) {}  // called once for each test, after its TestCleanup (so its failures come in between)
+    virtual void ForEachMessage(const UnitTestInfo&, _In_z_ const char*) {} // called for information from a test, e.g. TEST_STRESS's throughput
+    virtual void ForEachCounters(const UnitTestInfo&, const TestCounters&) {} // called after each test method, if the runner installed a TestInstrument
     virtual ~Reporter(){}
 };
 struct Discriminator
 {
     virtual bool WantTest(const UnitTestInfo&) { return true; } // return true if you want to run this test
+    virtual unsigned long long Shuffle() { return 0; } // non-zero: run the classes, and the tests in each, in an order drawn from this seed
+    virtual bool RunAgain(const UnitTestInfo&) { return false; } // called after each run of a test: true to run it again (on a new instance of its class)
+    virtual bool KeepModuleInitialized() { return false; } // true: skip TEST_MODULE_CLEANUP after this run, for later runs to reuse the module (until one returns false)
+    virtual bool Repeats() { return false; } // true if RunAgain might return true: then a TEST_METHOD_ASYNC which suspends is finished before it's asked, so that runs don't overlap
     virtual ~Discriminator(){}
 };
 
@@ -152,19 +216,122 @@ struct TestClassBase
     virtual void TestCleanup   () {} // after each test
 };
 
+// Failures which are recorded rather than thrown (TDD_EXPECT*, TddExpect(), Expect::, and TDD_VERIFY* when not throwing).
+// They're reported when the test method (or TestInitialize, TestCleanup, etc.) ends.
+// The buffer is preallocated, so recording a failure neither allocates nor throws. A message longer than
+// TDD_MAX_RECORDED_FAILURE_TEXT keeps its start and its end, with "..." between them; a path longer than
+// TDD_MAX_RECORDED_FAILURE_FILE keeps its end.
+#ifndef TDD_MAX_RECORDED_FAILURES
+ #define TDD_MAX_RECORDED_FAILURES 32
+#endif
+#ifndef TDD_MAX_RECORDED_FAILURE_TEXT
+ #define TDD_MAX_RECORDED_FAILURE_TEXT 1024
+#endif
+#ifndef TDD_MAX_RECORDED_FAILURE_FILE
+ #define TDD_MAX_RECORDED_FAILURE_FILE 512
+#endif
+class RecordedFailures
+{
+    struct Failure
+    {
+        unsigned long line;
+        char file [TDD_MAX_RECORDED_FAILURE_FILE];
+        char error[TDD_MAX_RECORDED_FAILURE_TEXT];
+    };
+    Failure m_failures[TDD_MAX_RECORDED_FAILURES];
+    unsigned int m_count, m_dropped;
+
+public:
+    // strcpy with truncation, which keeps head chars of a source that doesn't fit, then "...", then as much of its end as
+    // fits - written here so that tdd.h doesn't include any other headers
+    static void Copy(_Inout_count_(count) char* destination, int count, _In_z_ const char* source, int head)
+    {
+        int length = 0;
+        while (source[length])
+            ++length;
+        if (length < count || count < 4) {
+            while (--count > 0 && *source)
+                *destination++ = *source++;
+            *destination = 0;
+            return;
+        }
+        const int tail = count - 4 - head;
+        for (int i = 0; i < head; ++i)
+            *destination++ = source[i];
+        for (int i = 0; i < 3; ++i)
+            *destination++ = '.';
+        for (int i = length - tail; i < length; ++i)
+            *destination++ = source[i];
+        *destination = 0;
+    }
+    static void CopyError(_Inout_count_(count) char* destination, int count, _In_z_ const char* error) { Copy(destination, count, error, count < 4 ? 0 : (count - 4) / 2); }
+    static void CopyFile (_Inout_count_(count) char* destination, int count, _In_z_ const char* file)  { Copy(destination, count, file, 0); }
+
+    RecordedFailures() : m_count(0), m_dropped(0) {}
+
+    void Record(unsigned long line, _In_z_ const char* file, _In_z_ const char* error)
+    {
+        if (m_count == TDD_MAX_RECORDED_FAILURES) {
+            ++m_dropped;
+            return;
+        }
+        Failure& f = m_failures[m_count++];
+        f.line = line;
+        CopyFile (f.file,  TDD_MAX_RECORDED_FAILURE_FILE, file);
+        CopyError(f.error, TDD_MAX_RECORDED_FAILURE_TEXT, error);
+    }
+    void ReportAll(Reporter& r, _In_ const UnitTestInfo* uti)
+    {
+        for (unsigned int i = 0; i < m_count; ++i)
+            r.ForEachFailure(TestFailure(uti, m_failures[i].line, m_failures[i].file, m_failures[i].error));
+        if (m_dropped != 0)
+            r.ForEachFailure(TestFailure(uti, __LINE__, __FILE__, "more failures were recorded than fit in TDD_MAX_RECORDED_FAILURES"));
+        m_count = m_dropped = 0;
+    }
+    unsigned int Count() const { return m_count + m_dropped; }
+};
+
+// Failures from threads other than the test's own (see tddThreads.h), which go into a queue rather than RecordedFailures
+struct ThreadFailureSink // installed on such a thread, for the test which started it
+{
+    virtual void Record(unsigned long line, _In_z_ const char* file, _In_z_ const char* error) = 0;
+    virtual const UnitTestInfo* Test() const = 0;
+    virtual ~ThreadFailureSink() {}
+};
+struct ThreadFailureSource // the queue, emptied each time a test (or TestInitialize, etc.) ends
+{
+    virtual void ReportAll(Reporter& r, _In_ const UnitTestInfo* current) = 0; // each failure is reported with the test that started its thread
+    virtual ~ThreadFailureSource() {}
+};
+
 class Verifier
 {
-    static Reporter*& GetReporter()
+    TDD_LIBRARY_LOCAL static Reporter*& GetReporter()
     {
         static Reporter * s_reporter = 0;
         return s_reporter;
     }
-    static UnitTestInfo*& GetUnitTestInfo()
+    TDD_LIBRARY_LOCAL static UnitTestInfo*& GetUnitTestInfo()
     {
         static UnitTestInfo * s_uti = 0;
         return s_uti;
     }
+    TDD_LIBRARY_LOCAL static RecordedFailures& GetRecordedFailures()
+    {
+        static RecordedFailures s_failures;
+        return s_failures;
+    }
 public:
+    TDD_LIBRARY_LOCAL static ThreadFailureSink*& ThreadSink() // set on threads which a test started, 0 on the test's own
+    {
+        static TDD_THREAD_LOCAL ThreadFailureSink * s_sink = 0;
+        return s_sink;
+    }
+    TDD_LIBRARY_LOCAL static ThreadFailureSource*& ThreadFailures()
+    {
+        static ThreadFailureSource * s_source = 0;
+        return s_source;
+    }
     static void SetVerifierInfo(Reporter& reporter, UnitTestInfo& uti)
     {
         GetReporter() = &reporter;
@@ -177,46 +344,298 @@ public:
         // if exception handling semantics are defined and _TDD_NO_RETURN_ON_ASSERT_FAILURE isn't defined
         // then we throw exceptions to avoid continuing processing in the current execution context
         // if either exception handling semantics are undefined or _TDD_NO_RETURN_ON_ASSERT_FAILURE is defined
-        // then we just call the reporter with the failure and do not throw any exceptions
+        // then we just record the failure (to be reported at the end of the test) and do not throw any exceptions
         #if defined(_CPPUNWIND) && !defined(_TDD_NO_RETURN_ON_ASSERT_FAILURE)
             throw TDD::TddException(errorString, line, filename);
         #else
-            GetReporter()->ForEachFailure (TestFailure (GetUnitTestInfo(), line, filename, errorString));
+            Record(line, filename, errorString);
         #endif
         }        
     }
+    // not constexpr, so that calling it while the compiler evaluates a TEST_CONSTEXPR is a compile error, at the failing check
+    static void ConstexprFailure(unsigned long line, _In_z_ const char * filename, _In_z_ const char * errorString)
+    {
+        Verify(line, filename, false, errorString);
+    }
+    static void Expect(unsigned long line, _In_z_ const char * filename, bool b, _In_z_ const char * errorString)
+    {
+        if (false == b)
+            Record(line, filename, errorString);
+    }
+    static void Record(unsigned long line, _In_z_ const char * filename, _In_z_ const char * errorString)
+    {
+        if (ThreadSink())
+            ThreadSink()->Record(line, filename, errorString);
+        else
+            GetRecordedFailures().Record(line, filename, errorString);
+    }
+    static unsigned int RecordedFailureCount() { return GetRecordedFailures().Count(); } // on the test's own thread
+    static void ReportRecordedFailures()
+    {
+        GetRecordedFailures().ReportAll(*GetReporter(), GetUnitTestInfo());
+        if (ThreadFailures())
+            ThreadFailures()->ReportAll(*GetReporter(), GetUnitTestInfo());
+    }
+    static void Message(_In_z_ const char * message) // information, rather than a failure, about the current test
+    {
+        if (GetReporter() && GetUnitTestInfo())
+            GetReporter()->ForEachMessage(*GetUnitTestInfo(), message);
+    }
+    static const UnitTestInfo* CurrentTest() { return ThreadSink() ? ThreadSink()->Test() : GetUnitTestInfo(); } // the test (or TestInitialize, etc.) that's running
+};
+
+struct SnapshotStore // expected outputs for Assert::MatchesSnapshot; the runner installs one in Current()
+{
+    // the bytes must stay valid (and unchanged) for as long as the store does
+    virtual bool Find    (_In_z_ const char* key, const void*& data, unsigned long long& size) = 0;
+    virtual void Update  (_In_z_ const char* key, const void*  data, unsigned long long  size) = 0; // may be called from several threads
+    virtual bool Updating() const = 0; // true => MatchesSnapshot (re)writes snapshots, rather than comparing against them
+    virtual ~SnapshotStore() {}
+
+    TDD_LIBRARY_LOCAL static SnapshotStore*& Current()
+    {
+        static SnapshotStore * s_store = 0;
+        return s_store;
+    }
 };
 
+struct BaselineStore // expected timings for Assert::NoSlowerThanBaseline; the runner installs one in Current()
+{
+    virtual bool Find     (_In_z_ const char* key, double& nanoseconds) = 0;
+    virtual void Update   (_In_z_ const char* key, double  nanoseconds) = 0; // may be called from several threads
+    virtual bool Recording() const = 0; // true => NoSlowerThanBaseline records the timings, rather than comparing against them
+    virtual ~BaselineStore() {}
+
+    TDD_LIBRARY_LOCAL static BaselineStore*& Current()
+    {
+        static BaselineStore * s_store = 0;
+        return s_store;
+    }
+};
+
+struct TestInstrument // measures each test method (only the method, without its TestInitialize/TestCleanup); the runner installs one in Current()
+{
+    virtual void Start() = 0;
+    virtual void Stop(TestCounters& counters) = 0;
+    virtual ~TestInstrument() {}
+
+    TDD_LIBRARY_LOCAL static TestInstrument*& Current()
+    {
+        static TestInstrument * s_instrument = 0;
+        return s_instrument;
+    }
+};
+
+struct Tracer // records a timeline of the run: each phase of each test, and the spans which tests add; the runner installs one in Current()
+{
+    // group is the test class ("<Global>" for the module's phases), or 0 for a span which a test added; both strings are
+    // only valid during the call, so a tracer which keeps them copies them
+    virtual void Begin(_In_z_ const char* name, const char* group) = 0;
+    virtual void End() = 0; // of the span on this thread which began last
+    virtual ~Tracer() {}
+
+    TDD_LIBRARY_LOCAL static Tracer*& Current()
+    {
+        static Tracer * s_tracer = 0;
+        return s_tracer;
+    }
+};
+class TraceSpan // a span on the timeline, from construction to destruction: TDD_TRACE_SPAN("parse") in a test
+{
+    Tracer* const m_tracer;
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+public:
+    explicit TraceSpan(_In_z_ const char* name, const char* group = 0) : m_tracer(Tracer::Current()) { if (m_tracer) m_tracer->Begin(name, group); }
+    ~TraceSpan() { if (m_tracer) m_tracer->End(); }
+};
+
+struct TestCleanupCheck // run after each test's TestCleanup, and its failures are the test's; tddMock.h installs one in Current(), to verify the test's mocks
+{
+    virtual void Check(const UnitTestInfo& test) = 0; // the test which has just finished (as Running() was while it ran)
+    virtual ~TestCleanupCheck() {}
+
+    TDD_LIBRARY_LOCAL static TestCleanupCheck*& Current()
+    {
+        static TestCleanupCheck * s_check = 0;
+        return s_check;
+    }
+    // the test whose constructor, TestInitialize, method or TestCleanup is running, or 0 (e.g., in TestClassInitialize), so
+    // that what's made for a test can be told apart from what another test (a suspended TEST_METHOD_ASYNC) or none owns
+    TDD_LIBRARY_LOCAL static const UnitTestInfo*& Running()
+    {
+        static const UnitTestInfo * s_running = 0;
+        return s_running;
+    }
+    class RunningScope // sets Running() while it lives
+    {
+        const UnitTestInfo* m_outer;
+        RunningScope(const RunningScope&);
+        RunningScope& operator=(const RunningScope&);
+    public:
+        explicit RunningScope(const UnitTestInfo* test) : m_outer(Running()) { Running() = test; }
+        ~RunningScope() { Running() = m_outer; }
+    };
+};
+
+struct FixtureCache // state which TEST_CLASS_INITIALIZEs build, kept between runs for TDD_CACHED_FIXTURE; the runner installs one in Current()
+{
+    // the bytes must stay valid (and unchanged) for as long as the cache does, and be aligned for any type
+    virtual bool Find (_In_z_ const char* group, _In_z_ const char* name, const void*& data, unsigned long long& size) = 0;
+    virtual void Store(_In_z_ const char* group, _In_z_ const char* name, const void*  data, unsigned long long  size) = 0;
+    virtual ~FixtureCache() {}
+
+    TDD_LIBRARY_LOCAL static FixtureCache*& Current()
+    {
+        static FixtureCache * s_cache = 0;
+        return s_cache;
+    }
+};
+
+// For TEST_FUZZ: the target, which takes one input at a time, and the runner's engine, which gives it the inputs: those in
+// the test's corpus (and, when fuzzing it, mutations of them). Without an engine, the target is given an empty input.
+typedef decltype(sizeof(0)) FuzzSize;
+struct FuzzTarget
+{
+    virtual void Run(const unsigned char* data, FuzzSize size) = 0; // failures throw (or are recorded), as in any test
+    virtual ~FuzzTarget() {}
+};
+struct FuzzEngine // the runner installs one in Current()
+{
+    virtual void Run(const UnitTestInfo& test, FuzzTarget& target) = 0;
+    virtual ~FuzzEngine() {}
+
+    TDD_LIBRARY_LOCAL static FuzzEngine*& Current()
+    {
+        static FuzzEngine * s_engine = 0;
+        return s_engine;
+    }
+};
+template<typename C> class MemberFuzzTarget : public FuzzTarget
+{
+    C& m_instance;
+    void (C::*m_target)(const unsigned char*, FuzzSize);
+    MemberFuzzTarget& operator=(const MemberFuzzTarget&);
+public:
+    MemberFuzzTarget(C& instance, void (C::*target)(const unsigned char*, FuzzSize)) : m_instance(instance), m_target(target) {}
+    virtual void Run(const unsigned char* data, FuzzSize size) { (m_instance.*m_target)(data, size); }
+};
+template<typename C> void RunFuzzTarget(C& instance, void (C::*target)(const unsigned char*, FuzzSize))
+{
+    MemberFuzzTarget<C> t(instance, target);
+    if (FuzzEngine::Current() && Verifier::CurrentTest())
+        FuzzEngine::Current()->Run(*Verifier::CurrentTest(), t);
+    else
+        t.Run(0, 0);
+}
+
+struct LibraryHost // what a runner shares with the test libraries it loads, since each library has its own copy of the statics above
+{
+    SnapshotStore* snapshots;
+    BaselineStore* baselines;
+    TestInstrument* instrument;
+    FixtureCache* fixtures; // (for this library: the cache knows which build of it the fixtures came from)
+    FuzzEngine* fuzzer;
+    Tracer* tracer;
+};
+typedef void (*pfnRunTests)(Discriminator*, Reporter*, const LibraryHost*); // TddRunTests, exported by test libraries
+
+// Asynchronous test methods (TEST_METHOD_ASYNC, see tddAsync.h) may suspend, rather than return. Such a test method leaves
+// a SuspendedTest in Started(), and the runner keeps its test class alive, resuming it from the EventLoop until it's done;
+// only then does it call TestCleanup. A test class's suspended tests all wait on the loop together, so they overlap.
+struct SuspendedTest
+{
+    virtual bool Done() const = 0;
+    virtual bool Ready() const = 0; // what it's waiting for has happened (the event loop has woken it), so Resume() continues it
+    virtual void Resume() = 0; // continues the test, if it's Ready(); rethrows the exception that ended it, if any
+    virtual ~SuspendedTest() {}
+
+    TDD_LIBRARY_LOCAL static SuspendedTest*& Started()
+    {
+        static SuspendedTest * s_started = 0;
+        return s_started;
+    }
+};
+struct EventLoop
+{
+    virtual bool Wait() = 0; // blocks until some suspended test might continue; false if none ever can
+    virtual ~EventLoop() {}
+
+    TDD_LIBRARY_LOCAL static EventLoop*& Current()
+    {
+        static EventLoop * s_loop = 0;
+        return s_loop;
+    }
+};
+
+// Shuffled order: each class, and each test within its class, is keyed by a hash of the seed and its name, and they run
+// in key order. So any subset of the tests (e.g., when bisecting for an order dependency) keeps its relative order.
+inline unsigned long long ShuffleKey(unsigned long long seed, _In_z_ const char* name)
+{
+    unsigned long long h = 14695981039346656037ull ^ seed; // FNV-1a
+    while (*name)
+        h = (h ^ static_cast<unsigned char>(*name++)) * 1099511628211ull;
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdull; // and mix, so that similar names scatter
+    h ^= h >> 33; h *= 0xc4ceb3fe1a85ec53ull;
+    return h ^ (h >> 33);
+}
+
+// stable merge sort of a singly-linked list, where next(p) is a reference to p's link
+template<typename Node, typename Next, typename Less> Node* SortList(Node* head, Next next, Less less)
+{
+    if (!head || !next(head))
+        return head;
+    Node* middle = head;
+    for (Node* fast = next(head); fast && next(fast); fast = next(next(fast)))
+        middle = next(middle);
+    Node* b = SortList(next(middle), next, less);
+    next(middle) = 0;
+    Node* a = SortList(head, next, less);
+
+    Node* merged = 0;
+    Node** tail = &merged;
+    while (a && b) {
+        Node*& first = less(*b, *a) ? b : a; // a when they're equal, to keep it stable
+        *tail = first;
+        tail  = &next(first);
+        first = next(first);
+    }
+    *tail = a ? a : b;
+    return merged;
+}
+
 typedef void (*pfnModuleInitializeAndCleanup)();
 class ClassRegistrarBase
 {
     static void NullInitializer() {}
     ClassRegistrarBase* m_pNext;    // pointer to next test class entry
+    unsigned long long  m_order;    // registration order, or the shuffled order
+    unsigned int        m_index;    // registration order
 public:
-    ClassRegistrarBase() : m_pNext(0)
+    ClassRegistrarBase() : m_pNext(0), m_order(0), m_index(0)
     {
         AddClass(this); 
     }
     virtual ~ClassRegistrarBase(){}
 
-    static pfnModuleInitializeAndCleanup& GetModuleInitialize()
+    TDD_LIBRARY_LOCAL static pfnModuleInitializeAndCleanup& GetModuleInitialize()
     {
         static pfnModuleInitializeAndCleanup s_initialize = NullInitializer;
         return s_initialize;
     }
-    static pfnModuleInitializeAndCleanup& GetModuleCleanup()
+    TDD_LIBRARY_LOCAL static pfnModuleInitializeAndCleanup& GetModuleCleanup()
     {
         static pfnModuleInitializeAndCleanup s_cleanup = NullInitializer;
         return s_cleanup;
     }
 
 protected:
-    static bool& GetModuleInitializeFunctionWasCalled()
+    TDD_LIBRARY_LOCAL static bool& GetModuleInitializeFunctionWasCalled()
     {
         static bool s_bModuleInitializeFunctionWasCalled = false;
         return s_bModuleInitializeFunctionWasCalled;
     }
-    static bool& GetModuleInitializationFailed()
+    TDD_LIBRARY_LOCAL static bool& GetModuleInitializationFailed()
     {
         static bool s_bModuleInitializationFailed = false;
         return s_bModuleInitializationFailed;
@@ -224,21 +643,28 @@ protected:
 public:
     static void RunTests(_In_ Discriminator& d, _In_ Reporter& r)
     {
+        OrderTestTable(d.Shuffle());
         ClassRegistrarBase* p = GetTestTable();
         while (p) {
             p->RunClassTests(d, r);
             p = p->m_pNext;
         }
 
-        if (true == GetModuleInitializeFunctionWasCalled())
+        if (d.KeepModuleInitialized())
+            return;
+        if (true == GetModuleInitializeFunctionWasCalled()) {
+            TraceSpan span("TestModuleCleanup", "<Global>");
             TryCatchAndReport(r, "<Global>", [](){ GetModuleCleanup()(); }, "TestModuleCleanup", "unknown exception from TestModuleCleanup");
+        }
+        GetModuleInitializeFunctionWasCalled() = false; // so that the next run (e.g. a rerun in watch mode) initializes it again
+        GetModuleInitializationFailed()        = false;
     }
 
 protected:
-    template <typename L> static bool TryCatchAndReport(Reporter& r, const char* className, L l, _In_z_ const char * testname, _In_z_ const char * message) // L for lambda
+    template <typename L> static bool TryCatchAndReport(Reporter& r, const char* className, L l, _In_z_ const char * testname, _In_z_ const char * message, _In_z_ const char * classFile = "") // L for lambda
     {
         (void)message; // not used if _CPPUNWIND is not defined.
-        UnitTestInfo uti(className, testname);
+        UnitTestInfo uti(className, testname, classFile);
         Verifier::SetVerifierInfo(r, uti);
     #ifdef _CPPUNWIND
         try {
@@ -246,20 +672,33 @@ protected:
             l();
     #ifdef _CPPUNWIND
         } catch (TddException& e) {
+            Verifier::ReportRecordedFailures(); // these happened before the exception
             r.ForEachFailure (TestFailure (&uti, e.GetLine(), e.GetFile(), e.GetExceptionText()));
             return true;
         } catch (...) {
+            Verifier::ReportRecordedFailures();
             r.ForEachFailure (TestFailure (&uti, __LINE__, __FILE__, message));
             return true;
         }
     #endif
+        Verifier::ReportRecordedFailures(); // recorded failures don't stop anything, so they don't count as failing here
         return false;
     }
 
 private:
     virtual void RunClassTests(_In_ Discriminator& d, _In_ Reporter& r) = 0;
+    virtual const char* Name() const = 0;
+
+    static void OrderTestTable(unsigned long long seed) // by the seed, or back into registration order if it's 0
+    {
+        for (ClassRegistrarBase* p = GetTestTable(); p; p = p->m_pNext)
+            p->m_order = seed ? ShuffleKey(seed, p->Name()) : p->m_index;
+        GetTestTable() = SortList(GetTestTable(),
+                                  [](ClassRegistrarBase* p) -> ClassRegistrarBase*& { return p->m_pNext; },
+                                  [](const ClassRegistrarBase& a, const ClassRegistrarBase& b) { return a.m_order < b.m_order; });
+    }
 
-    static ClassRegistrarBase*& GetTestTable()
+    TDD_LIBRARY_LOCAL static ClassRegistrarBase*& GetTestTable()
     {
         static ClassRegistrarBase * s_table = 0;
         return s_table;
@@ -270,7 +709,12 @@ private:
         if (!p)   // empty: add to beginning
             GetTestTable() = t;
         else {
-            while (p->m_pNext) p = p->m_pNext;
+            for (;; p = p->m_pNext) {
+                if (t->m_index <= p->m_index)
+                    t->m_index = p->m_index + 1; // after all the others, even if they've been shuffled
+                if (!p->m_pNext)
+                    break;
+            }
             p->m_pNext = t;   // add to end
         }
     }
@@ -315,29 +759,87 @@ template<typename C> class TddAutoPtr
 public:
     explicit TddAutoPtr(C* p) : m_p(p) {}
     ~TddAutoPtr() { delete m_p; }
+    C* Release() { C* p = m_p; m_p = 0; return p; }
+    C* Get() const { return m_p; }
+    void Reset(C* p) { delete m_p; m_p = p; }
 };
 
+// For TDD_NO_HEAP: static storage for a T, which is constructed in it (with new (StaticPlacement(), buffer.Bytes()) T(...))
+// and destroyed by hand; zero-initialized, and trivially destructible, so it needs no constructor or destructor at exit
+template<typename T> struct StaticBuffer
+{
+    alignas(T) unsigned char m_bytes[sizeof(T)];
+    void* Bytes() { return m_bytes; }
+};
+struct StaticPlacement {}; // (placement new without <new>)
+template<typename C> class TddStaticPtr // TddAutoPtr for an object in a StaticBuffer: destroys it, but doesn't free it
+{
+    C* m_p;
+    TddStaticPtr(const TddStaticPtr&);
+    TddStaticPtr& operator=(const TddStaticPtr&);
+public:
+    explicit TddStaticPtr(C* p) : m_p(p) {}
+    ~TddStaticPtr() { if (m_p) m_p->~C(); }
+    C* Release() { C* p = m_p; m_p = 0; return p; }
+    C* Get() const { return m_p; }
+    void Reset(C* p) { if (m_p) m_p->~C(); m_p = p; }
+};
+} // namespace TDD
+inline void* operator new(decltype(sizeof(0)), TDD::StaticPlacement, void* p) { return p; }
+inline void operator delete(void*, TDD::StaticPlacement, void*) {} // (only called if a constructor throws)
+namespace TDD
+{
+
+// For TDD_CACHED_FIXTURE: state which would otherwise be built on every run, mapped straight from the runner's fixture
+// cache if this build of the test binary has stored it; otherwise, build fills in a new T, which goes into the cache for
+// the next run. T is stored as its bytes, so it mustn't hold pointers (use offsets, or indexes, instead).
+template<typename T, typename Build> const T& CachedFixture(_In_z_ const char* group, _In_z_ const char* name, Build build)
+{
+    static_assert(__is_trivially_copyable(T), "a cached fixture is stored as its bytes, so it must be trivially copyable");
+    FixtureCache* cache = FixtureCache::Current();
+    const void* data = 0;
+    unsigned long long size = 0;
+    if (cache && cache->Find(group, name, data, size) && size == sizeof(T))
+        return *static_cast<const T*>(data);
+
+#ifdef TDD_NO_HEAP
+    static StaticBuffer<T> s_buffer;
+    static T* s_built; // (a plain pointer, so that there's no destructor to register at exit)
+    if (s_built)
+        s_built->~T();
+    T* const built = s_built = new (StaticPlacement(), s_buffer.Bytes()) T();
+#else
+    static TddAutoPtr<T> s_built(0); // one for each use, since each has its own Build; replaced if the class runs again
+    s_built.Reset(new T());
+    T* const built = s_built.Get();
+#endif
+    build(*built);
+    if (cache)
+        cache->Store(group, name, built, sizeof(T));
+    return *built;
+}
+
 template<typename T> class ClassRegistrar : public ClassRegistrarBase
 {
     Reporter* m_r;
     // all test methods go through this function so that all exceptions/failures are reported.
-    template <typename L> bool TryCatchAndReport(L l, _In_z_ const char * testname, _In_z_ const char * message) { return ClassRegistrarBase::TryCatchAndReport(*m_r, ClassName(), l, testname, message); }
+    template <typename L> bool TryCatchAndReport(L l, _In_z_ const char * testname, _In_z_ const char * message) { return ClassRegistrarBase::TryCatchAndReport(*m_r, ClassName(), l, testname, message, FileName()); }
 public:
     struct TestMethodInfo : public UnitTestInfo
     {
         void (T::*m_pfn)();
         TestMethodInfo * m_pNext;
-        TestMethodInfo(const char* g, const char* t, void (T::*pfn)()) : UnitTestInfo(g, t), m_pfn(pfn), m_pNext(0) {}
+        TestMethodInfo(const char* g, const char* t, const char* f, void (T::*pfn)()) : UnitTestInfo(g, t, f), m_pfn(pfn), m_pNext(0) {}
         virtual ~TestMethodInfo() {}
     };
     class MethodRegistrar
     {
-        static const char*& ClassName()
+        TDD_LIBRARY_LOCAL static const char*& ClassName()
         {
             static const char* s_g = "not set yet";
             return s_g;
         }
-        static TestMethodInfo*& TestMethodTable()
+        TDD_LIBRARY_LOCAL static TestMethodInfo*& TestMethodTable()
         {
             static TestMethodInfo* s_testMethodInfo = 0;
             return s_testMethodInfo;
@@ -347,15 +849,26 @@ public:
         ~MethodRegistrar() { DestroyTestMethodTable(GetTestMethodTable()); }
 
         static TestMethodInfo* GetTestMethodTable() { return TestMethodTable(); }
+    #ifdef TDD_NO_HEAP
+        static void AddTestMethod(const char* t, void (T::*pfn)(), StaticBuffer<TestMethodInfo>& storage) // (TESTMETHOD's, one for each method)
+        {
+            Append(new (StaticPlacement(), storage.Bytes()) TestMethodInfo(ClassName(), t, ClassRegistrar::FileName(), pfn));
+        }
+    #else
         static void AddTestMethod(const char* t, void (T::*pfn)())
+        {
+            Append(new TestMethodInfo(ClassName(), t, ClassRegistrar::FileName(), pfn));
+        }
+    #endif
+        static void Append(TestMethodInfo* pInfo)
         {
             TestMethodInfo* p = TestMethodTable();
             if (!p)
-                TestMethodTable() = new TestMethodInfo(ClassName(), t, pfn);
+                TestMethodTable() = pInfo;
             else {
                 while (p->m_pNext)
                     p = p->m_pNext;
-                p->m_pNext = new TestMethodInfo(ClassName(), t, pfn);
+                p->m_pNext = pInfo;
             }
         }
         static void DisconnectTestTable() { TestMethodTable() = 0; } // caller will destroy table
@@ -363,25 +876,53 @@ public:
         {
              while (p) {
                  TestMethodInfo* next = p->m_pNext;
+    #ifdef TDD_NO_HEAP
+                 p->~TestMethodInfo();
+    #else
                  delete p;
+    #endif
                  p = next;
              }
              TestMethodTable() = 0;
         }
     };
+    struct SuspendedTestRun // a TEST_METHOD_ASYNC which has suspended, with the test class it's running in
+    {
+        T*                m_pTestClass;
+        TestMethodInfo*   m_pMethod;
+        SuspendedTest*    m_pTest;
+        SuspendedTestRun* m_pNext;
+        SuspendedTestRun(T* pTestClass, TestMethodInfo* pMethod, SuspendedTest* pTest, SuspendedTestRun* pNext) : m_pTestClass(pTestClass), m_pMethod(pMethod), m_pTest(pTest), m_pNext(pNext) {}
+        ~SuspendedTestRun() { delete m_pTest; delete m_pTestClass; }
+    };
 
 public:
-    ClassRegistrar(_In_z_ const char * classname)
+    ClassRegistrar(_In_z_ const char * classname, _In_z_ const char * filename = "")
     {
         ClassName() = classname;
+        FileName()  = filename;
     }
-    static const char *& ClassName()
+#ifdef TDD_NO_HEAP
+    static ClassRegistrar& Register(_In_z_ const char * classname, _In_z_ const char * filename) // TESTCLASS's, in static storage (and never destroyed)
+    {
+        static StaticBuffer<ClassRegistrar> s_registrar;
+        return *new (StaticPlacement(), s_registrar.Bytes()) ClassRegistrar(classname, filename);
+    }
+#endif
+    TDD_LIBRARY_LOCAL static const char *& ClassName()
     {
         static const char * s_classname = "no class name set!";
         return s_classname;
     }
+    TDD_LIBRARY_LOCAL static const char *& FileName()
+    {
+        static const char * s_filename = "";
+        return s_filename;
+    }
 
 private:
+    virtual const char* Name() const { return ClassName(); }
+
     TDD_MAKE_OPTIONAL_METHOD(T,TestClassInitialize);
     TDD_MAKE_OPTIONAL_METHOD(T,TestClassCleanup);
 
@@ -389,6 +930,137 @@ private:
      TDD_MAKE_100_OPTIONAL_METHODS(T,s_TDD__AddTest__);
 //  TDD_MAKE_1000_OPTIONAL_METHODS(T,s_TDD__AddTest__); // uncomment this line iff your test class has more than 100 test methods.  Compilation will be slow :(
 
+    void CheckAfterCleanup(const TestMethodInfo* pTest)
+    {
+        if (TestCleanupCheck::Current())
+            TryCatchAndReport([pTest](){ TestCleanupCheck::Current()->Check(*pTest); }, pTest->testname, "unknown exception from TestCleanupCheck");
+    }
+    bool Resume(SuspendedTestRun* p)
+    {
+        TraceSpan span(p->m_pMethod->testname, ClassName());
+        TestCleanupCheck::RunningScope running(p->m_pMethod);
+        return TryCatchAndReport([p]() { p->m_pTest->Resume(); }, p->m_pMethod->testname, "unknown exception:  continuing anyway");
+    }
+    // resumes the suspended tests as the event loop wakes them, and cleans up after each one as it finishes
+    void FinishSuspendedTests(SuspendedTestRun*& pSuspended)
+    {
+        while (pSuspended) {
+            EventLoop* loop = EventLoop::Current();
+            const bool stuck = !loop || !loop->Wait();
+            for (SuspendedTestRun** pp = &pSuspended; *pp; ) {
+                SuspendedTestRun* p = *pp;
+                T& testClass = *p->m_pTestClass;
+                if (p->m_pTest->Ready()) {
+                    if (false == Resume(p) && !p->m_pTest->Done()) {
+                        pp = &p->m_pNext;
+                        continue; // waiting again
+                    }
+                } else if (!stuck) {
+                    pp = &p->m_pNext;
+                    continue; // still waiting (and not resumed, so there's no empty span in a --trace)
+                } else {
+                    m_r->ForEachFailure(TestFailure(p->m_pMethod, __LINE__, __FILE__, "asynchronous test is waiting for something the event loop doesn't know about"));
+                }
+                {
+                    TraceSpan span("TestCleanup", ClassName());
+                    TestCleanupCheck::RunningScope running(p->m_pMethod);
+                    TryCatchAndReport([&testClass](){ static_cast<TestClassBase&>(testClass).TestCleanup(); }, "TestCleanup", "unknown exception from TestCleanup");
+                    CheckAfterCleanup(p->m_pMethod);
+                }
+                m_r->ForEachTestEnd(*p->m_pMethod);
+                *pp = p->m_pNext;
+                delete p;
+            }
+        }
+    }
+    // runs one test: returns false if it's a TEST_METHOD_ASYNC which has suspended, and so hasn't finished yet
+    bool RunTest(TestMethodInfo* pCurrentTest, bool& bClassInitializeFunctionWasCalled, bool& bInitializationFailed, SuspendedTestRun*& pSuspended)
+    {
+        if (GetModuleInitializationFailed() == true) { // module initialization failed; report that every test can't run
+            m_r->ForEachFailure(TestFailure(pCurrentTest, __LINE__, __FILE__, "test module initialization failure: can't run test!"));
+            return true;
+        }
+        if (bInitializationFailed == true) { // class initialization failed; report that every test can't run
+            m_r->ForEachFailure(TestFailure(pCurrentTest, __LINE__, __FILE__, "test class initialization failure: can't run test!"));
+            return true;
+        }
+
+        // initialize module only once
+        if (GetModuleInitializeFunctionWasCalled() == false) {
+            GetModuleInitializeFunctionWasCalled() = true;
+            TraceSpan span("TestModuleInitialize", "<Global>");
+            GetModuleInitializationFailed() |= TryCatchAndReport([](){ GetModuleInitialize()(); }, "TestModuleInitialize", "unknown exception from TestModuleInitialize");
+            if (GetModuleInitializationFailed() == true)
+                return true; // already reported failure; can't proceed
+        }
+
+        // initialize test class only once
+        if (bClassInitializeFunctionWasCalled == false) {
+            bClassInitializeFunctionWasCalled = true;
+            TraceSpan span("TestClassInitialize", ClassName());
+            bInitializationFailed |= TryCatchAndReport([](){ CallTestClassInitialize(); }, "TestClassInitialize", "unknown exception from TestClassInitialize");
+            if (bInitializationFailed == true)
+                return true; // already reported failure; can't proceed
+        }
+
+        TestCleanupCheck::RunningScope running(pCurrentTest); // (until it's finished, or has suspended)
+
+        // create a new instance of the test class for each test that the user wants to run
+        T* pTestClass = 0;
+        {
+            TraceSpan span("constructor", ClassName());
+        #ifdef TDD_NO_HEAP
+            static StaticBuffer<T> s_instance; // (only one at a time)
+            bInitializationFailed |= TryCatchAndReport([&pTestClass]() { pTestClass = new (StaticPlacement(), s_instance.Bytes()) T(); }, "constructor", "unknown exception:  continuing anyway");
+        #else
+            bInitializationFailed |= TryCatchAndReport([&pTestClass]() { pTestClass = new T(); }, "constructor", "unknown exception:  continuing anyway");
+        #endif
+        }
+        if (bInitializationFailed == true)
+            return true; // already reported failure; can't proceed
+
+        T& testClass = *pTestClass;
+    #ifdef TDD_NO_HEAP
+        TddStaticPtr<T> tap(pTestClass);
+    #else
+        TddAutoPtr<T> tap(pTestClass);
+    #endif
+
+        // TestInitialize
+        bool bTestInitializeFailed = false;
+        {
+            TraceSpan span("TestInitialize", ClassName());
+            bTestInitializeFailed = TryCatchAndReport([&testClass](){ static_cast<TestClassBase&>(testClass).TestInitialize(); }, "TestInitialize", "unknown exception from TestInitialize");
+        }
+        if (false == bTestInitializeFailed)
+        {   // all init'ed, run the test
+            SuspendedTest::Started() = 0;
+            TraceSpan span(pCurrentTest->testname, ClassName()); // (for a TEST_METHOD_ASYNC, up to where it first waits, as for the instrument)
+            TestInstrument* pInstrument = TestInstrument::Current();
+            if (pInstrument)
+                pInstrument->Start();
+            TryCatchAndReport([&testClass, pCurrentTest]() { (testClass.*(pCurrentTest->m_pfn))(); }, pCurrentTest->testname, "unknown exception:  continuing anyway");
+            if (pInstrument) { // (for a TEST_METHOD_ASYNC, only up to where it first waits)
+                TestCounters counters;
+                pInstrument->Stop(counters);
+                m_r->ForEachCounters(*pCurrentTest, counters);
+            }
+            if (SuspendedTest::Started()) { // it's waiting: finish it, and clean up, once the class's other tests have started
+                pSuspended = new SuspendedTestRun(tap.Release(), pCurrentTest, SuspendedTest::Started(), pSuspended);
+                SuspendedTest::Started() = 0;
+                return false;
+            }
+        }
+
+        // TestCleanup (no matter what)
+        {
+            TraceSpan span("TestCleanup", ClassName());
+            TryCatchAndReport([&testClass](){ static_cast<TestClassBase&>(testClass).TestCleanup(); }, "TestCleanup", "unknown exception from TestCleanup");
+            CheckAfterCleanup(pCurrentTest);
+        }
+        return true;
+    }
+
     virtual void RunClassTests(_In_ Discriminator& d, _In_ Reporter& r)
     {
         m_r = &r; // hang onto this so I don't have to keep passing it to TryCatchAndReport
@@ -397,6 +1069,7 @@ private:
         bool bInitializationFailed             = false; // if static ctor or TestClassInitialize failed
 
         TestMethodInfo* pTestTable = 0;
+        SuspendedTestRun* pSuspended = 0; // TEST_METHOD_ASYNCs which are waiting
 
     #ifdef _CPPUNWIND
         try
@@ -413,69 +1086,47 @@ private:
             if (!pCurrentTest)
                 return; // no tests to run
 
+            if (const unsigned long long seed = d.Shuffle())
+                pCurrentTest = SortList(pCurrentTest,
+                                        [](TestMethodInfo* p) -> TestMethodInfo*& { return p->m_pNext; },
+                                        [seed](const TestMethodInfo& a, const TestMethodInfo& b) { return ShuffleKey(seed, a.testname) < ShuffleKey(seed, b.testname); });
+
             pTestTable = pCurrentTest;    // I'm dong this because a few of my unit tests call this method recursively.  
             mrb.DisconnectTestTable();    // Since MethodRegistrar holds a static, that doesn't work.
                                           // So I'm placing the table in a local variable and will destroy it myself after the "try/catch" block
 
             do {
                 if (d.WantTest(*pCurrentTest)) {
-                    r.ForEachTest(*pCurrentTest);
-
-                    if (GetModuleInitializationFailed() == true) { // module initialization failed; report that every test can't run
-                        r.ForEachFailure(TestFailure(pCurrentTest, __LINE__, __FILE__, "test module initialization failure: can't run test!"));
-                        continue;
-                    }
-                    if (bInitializationFailed == true) { // class initialization failed; report that every test can't run
-                        r.ForEachFailure(TestFailure(pCurrentTest, __LINE__, __FILE__, "test class initialization failure: can't run test!"));
-                        continue;
-                    }
-
-                    // initialize module only once
-                    if (GetModuleInitializeFunctionWasCalled() == false) {
-                        GetModuleInitializeFunctionWasCalled() = true;
-                        GetModuleInitializationFailed() |= TryCatchAndReport([](){ GetModuleInitialize()(); }, "TestModuleInitialize", "unknown exception from TestModuleInitialize");
-                        if (GetModuleInitializationFailed() == true)
-                            continue; // already reported failure; can't proceed
-                    }
-
-                    // initialize test class only once
-                    if (bClassInitializeFunctionWasCalled == false) {
-                        bClassInitializeFunctionWasCalled = true;
-                        bInitializationFailed |= TryCatchAndReport([](){ CallTestClassInitialize(); }, "TestClassInitialize", "unknown exception from TestClassInitialize");
-                        if (bInitializationFailed == true)
-                            continue; // already reported failure; can't proceed
-                    }
-
-                    // create a new instance of the test class for each test that the user wants to run
-                    T* pTestClass = 0;
-                    bInitializationFailed |= TryCatchAndReport([&pTestClass]() { pTestClass = new T(); }, "constructor", "unknown exception:  continuing anyway");
-                    if (bInitializationFailed == true)
-                        continue; // already reported failure; can't proceed
-
-                    T& testClass = *pTestClass;
-                    TddAutoPtr<T> tap(pTestClass);
-
-                    // TestInitialize
-                    if (false == TryCatchAndReport([&testClass](){ static_cast<TestClassBase&>(testClass).TestInitialize(); }, "TestInitialize", "unknown exception from TestInitialize"))
-                    {   // all init'ed, run the test
-                        TryCatchAndReport([&testClass, pCurrentTest]() { (testClass.*(pCurrentTest->m_pfn))(); }, pCurrentTest->testname, "unknown exception:  continuing anyway");
-                    }
-
-                    // TestCleanup (no matter what)
-                    TryCatchAndReport([&testClass](){ static_cast<TestClassBase&>(testClass).TestCleanup(); }, "TestCleanup", "unknown exception from TestCleanup");
+                    do {
+                        r.ForEachTest(*pCurrentTest);
+                        if (RunTest(pCurrentTest, bClassInitializeFunctionWasCalled, bInitializationFailed, pSuspended))
+                            r.ForEachTestEnd(*pCurrentTest); // (a suspended test ends in FinishSuspendedTests)
+                        else if (d.Repeats())
+                            FinishSuspendedTests(pSuspended);
+                    } while (d.RunAgain(*pCurrentTest));
                 }
             } while (0 != (pCurrentTest = pCurrentTest->m_pNext)); // next test!
+
+            FinishSuspendedTests(pSuspended);
         
     #ifdef _CPPUNWIND
         } catch (...) {
             // inexplicable exception:  I tried very hard to wrap any possibly throwing calls inside TryCatchAndReport, but something must have gotten through
-            UnitTestInfo uti(ClassName(), "inexplicable exception");
+            UnitTestInfo uti(ClassName(), "inexplicable exception", FileName());
             r.ForEachFailure (TestFailure(&uti, __LINE__, __FILE__, "An unexpected exception was thrown"));
     #endif
         }
 
-        if (true == bClassInitializeFunctionWasCalled)
+        while (pSuspended) { // only if something threw past FinishSuspendedTests
+            SuspendedTestRun* next = pSuspended->m_pNext;
+            delete pSuspended;
+            pSuspended = next;
+        }
+
+        if (true == bClassInitializeFunctionWasCalled) {
+            TraceSpan span("TestClassCleanup", ClassName());
             TryCatchAndReport([](){ CallTestClassCleanup(); }, "TestClassCleanup", "unknown exception from TestClassCleanup");
+        }
 
         if (pTestTable)
             MethodRegistrar::DestroyTestMethodTable(pTestTable);
@@ -520,34 +1171,158 @@ struct NamespaceResolver
         return namespaces;
     }
 };
+#ifdef TDD_CONSTEXPR_NAMES
+// The qualified name of the class whose TESTCLASS generated a resolver, from the signature of the resolver's Signature():
+//     gcc:   "static constexpr const char* NS::{anonymous}::Class_TddNamespaceResolver::Signature()"
+//     clang: "static const char *NS::(anonymous namespace)::Class_TddNamespaceResolver::Signature()"
+//     MSVC:  "NS::`anonymous-namespace'::Class_TddNamespaceResolver::Signature"
+// all give "NS::{anonymous}::Class".
+template<int N> struct ClassNameFromSignature
+{
+    char text[N];
+
+    static constexpr int Length(const char* s) { int n = 0; while (s[n]) ++n; return n; }
+    static constexpr bool At(const char* s, int i, const char* word) { for (int j = 0; word[j]; ++j) if (s[i + j] != word[j]) return false; return true; }
+    static constexpr bool IsNameChar(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':'; }
+    static constexpr const char* Anonymous(int i) { return i == 0 ? "{anonymous}" : i == 1 ? "(anonymous namespace)" : "`anonymous-namespace'"; }
+
+    constexpr explicit ClassNameFromSignature(const char* signature) : text()
+    {
+        int end = 0;
+        while (signature[end] && !At(signature, end, "_TddNamespaceResolver"))
+            ++end;
+        int begin = end; // back to the start of the qualified name
+        for (bool more = true; more; ) {
+            more = false;
+            if (begin > 0 && IsNameChar(signature[begin - 1])) {
+                --begin;
+                more = true;
+            }
+            for (int a = 0; a < 3 && !more; ++a) {
+                const int length = Length(Anonymous(a));
+                if (begin >= length && At(signature, begin - length, Anonymous(a))) {
+                    begin -= length;
+                    more = true;
+                }
+            }
+        }
+        int out = 0; // "{anonymous}" is the shortest spelling, so the name fits
+        for (int i = begin; i < end; ) {
+            bool anonymous = false;
+            for (int a = 0; a < 3 && !anonymous; ++a) {
+                if (At(signature, i, Anonymous(a))) {
+                    for (const char* c = Anonymous(0); *c; ++c)
+                        text[out++] = *c;
+                    i += Length(Anonymous(a));
+                    anonymous = true;
+                }
+            }
+            if (!anonymous)
+                text[out++] = signature[i++];
+        }
+        text[out] = 0;
+    }
+};
+#endif
 template<typename T> struct TheClassTypedefer { typedef T TheClass; };
 
 struct TMI { TMI(void(*pfn)()) { TDD::ClassRegistrarBase::GetModuleInitialize() = pfn; } };
 struct TMC { TMC(void(*pfn)()) { TDD::ClassRegistrarBase::GetModuleCleanup()    = pfn; } };
 
 } // namespace TDD
+TDD_LIBRARY_LOCAL_END
+
+#ifdef TDD_TEST_LIBRARY
+ #ifdef _WIN32
+  #define TDD_EXPORT __declspec(dllexport)
+ #else
+  #define TDD_EXPORT __attribute__((visibility("default"), used))
+ #endif
+extern "C" TDD_EXPORT inline void TddRunTests(TDD::Discriminator* d, TDD::Reporter* r, const TDD::LibraryHost* host)
+{
+    if (host)
+    {
+        TDD::SnapshotStore::Current() = host->snapshots;
+        TDD::BaselineStore::Current() = host->baselines;
+        TDD::TestInstrument::Current() = host->instrument;
+        TDD::FixtureCache::Current() = host->fixtures;
+        TDD::FuzzEngine::Current() = host->fuzzer;
+        TDD::Tracer::Current() = host->tracer;
+    }
+    TDD::ClassRegistrarBase::RunTests(*d, *r);
+}
+#endif
 
 
-#ifdef __PRETTY_FUNCTION__ // allow for differences on Mac and gcc
+#if defined(__GNUC__) || defined(__clang__) // __FUNCTION__ is just the function's name there: __PRETTY_FUNCTION__ has its namespaces and class
     #define TDD__FUNCTION__ __PRETTY_FUNCTION__
 #else
     #define TDD__FUNCTION__ __FUNCTION__
 #endif
 
+#ifdef TDD_CONSTEXPR_NAMES
+#define TDD_NAMESPACE_RESOLVER(classname) \
+    struct TDD_LIBRARY_LOCAL classname##_TddNamespaceResolver { static constexpr const char* Signature() { return TDD__FUNCTION__; } \
+    TDD_LIBRARY_LOCAL static const char* GetNameSpace() { static constexpr TDD::ClassNameFromSignature<TDD::ClassNameFromSignature<1>::Length(Signature()) + 1> s_name(Signature()); return s_name.text; } };
+#else
+#define TDD_NAMESPACE_RESOLVER(classname) \
+    struct TDD_LIBRARY_LOCAL classname##_TddNamespaceResolver : public TDD::NamespaceResolver { classname##_TddNamespaceResolver() { name = TDD__FUNCTION__; } \
+    TDD_LIBRARY_LOCAL static const char* GetNameSpace() { static char s_sig[sizeof(TDD__FUNCTION__)+20] = {0}; Copy(s_sig, sizeof(s_sig), classname##_TddNamespaceResolver().name);  return TrimClassName(s_sig, sizeof(s_sig), "_TddNamespaceResolver"); } };
+#endif
+
+#ifdef TDD_NO_HEAP
+#define TESTCLASS(classname) \
+    TDD_NAMESPACE_RESOLVER(classname) \
+    class classname; TDD::ClassRegistrar<classname>& g_##classname##_variable = TDD::ClassRegistrar<classname>::Register(classname##_TddNamespaceResolver::GetNameSpace(), __FILE__); \
+    class TDD_LIBRARY_LOCAL classname : public TDD::TestClassBase, private TDD::TheClassTypedefer<classname>
+#else
 #define TESTCLASS(classname) \
-    struct classname##_TddNamespaceResolver : public TDD::NamespaceResolver { classname##_TddNamespaceResolver() { name = TDD__FUNCTION__; } \
-    static const char* GetNameSpace() { static char s_sig[sizeof(TDD__FUNCTION__)+20] = {0}; Copy(s_sig, sizeof(s_sig), classname##_TddNamespaceResolver().name);  return TrimClassName(s_sig, sizeof(s_sig), "_TddNamespaceResolver"); } }; \
-    class classname; TDD::TddAutoPtr<TDD::ClassRegistrar<classname> > g_##classname##_variable(new TDD::ClassRegistrar<classname>(classname##_TddNamespaceResolver::GetNameSpace())); \
-    class classname : public TDD::TestClassBase, private TDD::TheClassTypedefer<classname>
+    TDD_NAMESPACE_RESOLVER(classname) \
+    class classname; TDD::TddAutoPtr<TDD::ClassRegistrar<classname> > g_##classname##_variable(new TDD::ClassRegistrar<classname>(classname##_TddNamespaceResolver::GetNameSpace(), __FILE__)); \
+    class TDD_LIBRARY_LOCAL classname : public TDD::TestClassBase, private TDD::TheClassTypedefer<classname>
+#endif
 
 #define __TDD_CONCAT2__(x,y) x##y
 #define __TDD_CONCAT1__(x,y) __TDD_CONCAT2__(x,y)
 #define __TDD_ADDTEST__ __TDD_CONCAT1__(public: static void s_TDD__AddTest__,__COUNTER__) // if your compiler doesn't suppoert __COUNTER__, try __LINE__. It'll work, but you'll probably have to turn on TDD_MAKE_1000_OPTIONAL_METHODS/TDD_CALL_1000_OPTIONAL_METHODS, which will be slow.
 
+#ifdef TDD_NO_HEAP
+#define TESTMETHOD(methodname) __TDD_ADDTEST__() { static ::TDD::StaticBuffer< ::TDD::ClassRegistrar<TheClass>::TestMethodInfo> s_info; ::TDD::ClassRegistrar<TheClass>::MethodRegistrar::AddTestMethod(#methodname, &TheClass::methodname##_test_method, s_info); } virtual void methodname##_test_method()
+#else
 #define TESTMETHOD(methodname) __TDD_ADDTEST__() { ::TDD::ClassRegistrar<TheClass>::MethodRegistrar::AddTestMethod(#methodname, &TheClass::methodname##_test_method); } virtual void methodname##_test_method() // virtual to avoid PREfast warning 25007
+#endif
+
+// TEST_CONSTEXPR(name) { ... TDD_CONSTEXPR_VERIFY(expression); ... }: the body is a constexpr function, which the compiler
+// evaluates as it compiles the test method, so a failing check is a compile error (pointing at the check), and the test
+// costs nothing at run time. It's still registered as a test method, to be reported, filtered and counted.
+#ifdef TDD_CONSTEXPR_TESTS
+#define TESTCONSTEXPR(methodname) \
+    TESTMETHOD(methodname) { ::TDD::ConstexprTest<&TheClass::methodname##_constexpr_test>(); } \
+    static constexpr void methodname##_constexpr_test()
+#else
+#define TESTCONSTEXPR(methodname) TESTMETHOD(methodname) // checked at run time instead
+#endif
+#ifdef TDD_CONSTEXPR_TESTS
+namespace TDD
+{
+    // a template, so that it's instantiated after the test class (and the body, which comes after the test method) is complete
+    template<void (*body)()> inline void ConstexprTest() { static_assert((body(), true), "a TEST_CONSTEXPR failed: see the TDD_CONSTEXPR_VERIFY which wasn't a constant expression"); }
+}
+#endif
+// TEST_FUZZ(name)(const uint8_t* data, size_t size) { ... }: a fuzz target, registered as a test method, which checks
+// (with asserts, like any test) that the code under test copes with any input. The runner gives it each input in its
+// corpus, and, when asked to fuzz it, mutations of them (see PortableRunner/Fuzzer.h).
+#define TESTFUZZ(methodname) \
+    TESTMETHOD(methodname) { ::TDD::RunFuzzTarget(*this, &TheClass::methodname##_fuzz_target); } \
+    void methodname##_fuzz_target
+
+#define TDD_CONSTEXPR_VERIFY(arg)              ((arg) ? void(0) : ::TDD::Verifier::ConstexprFailure(__LINE__, __FILE__, "TDD_CONSTEXPR_VERIFY("#arg")"))
+#define TDD_CONSTEXPR_VERIFY_EQUAL(arg1, arg2) (((arg1) == (arg2)) ? void(0) : ::TDD::Verifier::ConstexprFailure(__LINE__, __FILE__, "TDD_CONSTEXPR_VERIFY_EQUAL("#arg1", "#arg2")"))
 
 #define TEST_CLASS(className)              TESTCLASS(className)
 #define TEST_METHOD(methodName)            TESTMETHOD(methodName)
+#define TEST_CONSTEXPR(methodName)         TESTCONSTEXPR(methodName)
+#define TEST_FUZZ(methodName)              TESTFUZZ(methodName)
 #define TEST_MODULE_INITIALIZE(n)          void TestModuleInitialize(); ::TDD::TMI __TDD__tmi__(TestModuleInitialize); void TestModuleInitialize()
 #define TEST_MODULE_CLEANUP(n)             void TestModuleCleanup   (); ::TDD::TMC __TDD__tmc__(TestModuleCleanup);    void TestModuleCleanup()
 #define TEST_CLASS_INITIALIZE(ignoreName)  public: static  void TestClassInitialize()
@@ -555,6 +1330,12 @@ struct TMC { TMC(void(*pfn)()) { TDD::ClassRegistrarBase::GetModuleCleanup()
 #define TEST_METHOD_INITIALIZE(ignoreName) public: virtual void TestInitialize()
 #define TEST_METHOD_CLEANUP(ignoreName)    public: virtual void TestCleanup()
 
+// in a TEST_CLASS_INITIALIZE: s_table = &TDD_CACHED_FIXTURE(Table, "table", [](Table& t) { ... fill in t ... });
+#define TDD_CACHED_FIXTURE(type, name, build) ::TDD::CachedFixture<type>(::TDD::ClassRegistrar<TheClass>::ClassName(), name, build)
+
+// in a test: a span on the runner's timeline (e.g. PortableRunner --trace) until the end of the scope; name is copied as it begins
+#define TDD_TRACE_SPAN(name) ::TDD::TraceSpan __TDD_CONCAT1__(__tdd_trace_span_, __LINE__)(name)
+
 // in case you want to disable slow tests:  no registration mechanism => no tests
 #define SKIP_TEST_CLASS(classname) class classname : public TDD::TestClassBase, private TDD::TheClassTypedefer<classname>
 #define SKIP_TEST_METHOD(a) void a(void)
@@ -606,6 +1387,14 @@ struct TMC { TMC(void(*pfn)()) { TDD::ClassRegistrarBase::GetModuleCleanup()
                                              TDD::Verifier::Verify(__LINE__, __FILE__, __tdd_b, "TDD_VERIFY_HRESULT("#arg")"); \
                                              TDD_VERIFY_RETURN_ON_FAILURE; __pragma(warning(push)) __pragma(warning(disable:4127)) \
                                          } while(false) __pragma(warning(pop))
+
+// the TDD_EXPECT* macros record the failure, and the test carries on: no exceptions, no early return
+#define TDD_EXPECT(arg)                  do { TDD::Verifier::Expect(__LINE__, __FILE__, (arg), "TDD_EXPECT("#arg")"); __pragma(warning(push)) __pragma(warning(disable:4127)) \
+                                         } while(false) __pragma(warning(pop))
+#define TDD_EXPECT_EQUAL(arg1, arg2)     do { TDD::Verifier::Expect(__LINE__, __FILE__, ((arg1) == (arg2)), "TDD_EXPECT_EQUAL("#arg1", "#arg2")"); __pragma(warning(push)) __pragma(warning(disable:4127)) \
+                                         } while(false) __pragma(warning(pop))
+#define TDD_EXPECT_NOT_EQUAL(arg1, arg2) do { TDD::Verifier::Expect(__LINE__, __FILE__, ((arg1) != (arg2)), "TDD_EXPECT_NOT_EQUAL("#arg1", "#arg2")"); __pragma(warning(push)) __pragma(warning(disable:4127)) \
+                                         } while(false) __pragma(warning(pop))
 #define TDD_FAILURE(errorString)         do { TDD::Verifier::Verify(__LINE__, __FILE__, false, errorString); TDD_VERIFY_RETURN; } __pragma(warning(push)) __pragma(warning(disable:4127)) \
                                          while(false) __pragma(warning(pop))
 #define TDD_EXCEPTION(errorString)       do { TDD::Verifier::Verify(__LINE__, __FILE__, false, errorString); TDD_VERIFY_RETURN; } __pragma(warning(push)) __pragma(warning(disable:4127)) \
@@ -18,6 +18,7 @@
  #endif
 #endif
 
+TDD_LIBRARY_LOCAL_BEGIN
 namespace TDD
 {
 
@@ -30,27 +31,158 @@ template <typename string, typename T> string ToString(const T& t) { static_asse
 template <typename string>               bool IsEmpty (const string& s);
 template <typename string>        const char* ToAsciiz(const string& s);
 
+// Tolerance for comparing arrays of floats or doubles. An element passes if it is exactly equal or within _any_ of the enabled tolerances, e.g.:
+//     TddAssert().IsWithin(expected, actual, count, TDD::Tolerance().Absolute(1e-12).Ulps(4));
+// With no tolerance enabled, elements must be exactly equal; an infinity only ever matches itself.
+class Tolerance
+{
+	double             m_absolute; // |expected - actual| <= absolute
+	double             m_relative; // |expected - actual| <= relative * max(|expected|, |actual|)
+	unsigned long long m_ulps;     // at most this many representable values apart
+	bool               m_nanEqual; // NaN matches NaN
+public:
+	Tolerance() : m_absolute(0), m_relative(0), m_ulps(0), m_nanEqual(false) {}
+	Tolerance& Absolute    (double a)             { m_absolute = a < 0 ? -a : a; return *this; }
+	Tolerance& Relative    (double r)             { m_relative = r < 0 ? -r : r; return *this; }
+	Tolerance& Ulps        (unsigned long long u) { m_ulps     = u;              return *this; }
+	Tolerance& NansAreEqual(bool b = true)        { m_nanEqual = b;              return *this; }
+
+	double             GetAbsolute() const { return m_absolute; }
+	double             GetRelative() const { return m_relative; }
+	unsigned long long GetUlps    () const { return m_ulps; }
+	bool               NanEqual   () const { return m_nanEqual; }
+};
+
+namespace Details
+{
+	typedef decltype(sizeof(0)) size_type;
+
+	template <typename F> struct FloatTraits;
+	template <> struct FloatTraits<float>  { typedef unsigned int       Bits; };
+	template <> struct FloatTraits<double> { typedef unsigned long long Bits; };
+
+	template <typename F> bool IsNan(F f) { return f != f; }
+	template <typename F> bool IsFinite(F f) { return f - f == F(0); } // (inf - inf and NaN - NaN are NaN)
+	template <typename F> F    Abs  (F f) { return f < 0 ? -f : f; } // avoid std::fabs.
+
+	// maps the bits of f onto an unsigned scale on which adjacent floats are adjacent integers (and -0 == +0)
+	template <typename F> typename FloatTraits<F>::Bits OrderedBits(F f)
+	{
+		typedef typename FloatTraits<F>::Bits Bits;
+		static_assert(sizeof(Bits) == sizeof(F), "unexpected floating-point size");
+	#if (defined(_MSC_VER) && _MSC_VER >= 1926) || (defined(__GNUC__) && __GNUC__ >= 11) || defined(__clang__)
+		const Bits bits = __builtin_bit_cast(Bits, f); // std::bit_cast, without requiring C++20 or <bit>
+	#else
+		union { F f; Bits b; } pun;
+		pun.f = f;
+		const Bits bits = pun.b;
+	#endif
+		const Bits sign = Bits(1) << (sizeof(Bits) * 8 - 1);
+		return (bits & sign) ? Bits(~bits + 1) : Bits(bits | sign);
+	}
+	template <typename F> unsigned long long UlpDistance(F a, F b)
+	{
+		const typename FloatTraits<F>::Bits x = OrderedBits(a), y = OrderedBits(b);
+		return x < y ? y - x : x - y;
+	}
+
+	// deliberately branch-free (note the bitwise operators), so that the all-pass loop in CompareArrays vectorizes
+	template <typename F> struct ElementTolerance
+	{
+		F absolute, relative; typename FloatTraits<F>::Bits ulps; bool nanEqual;
+		explicit ElementTolerance(const Tolerance& t)
+			: absolute(F(t.GetAbsolute())), relative(F(t.GetRelative()))
+			, ulps(typename FloatTraits<F>::Bits(t.GetUlps() < typename FloatTraits<F>::Bits(-1) ? t.GetUlps() : typename FloatTraits<F>::Bits(-1)))
+			, nanEqual(t.NanEqual())
+		{}
+		bool IsClose(F expected, F actual) const
+		{
+			const bool finite = IsFinite(expected) & IsFinite(actual); // an infinity is only close to itself (rel * inf is inf)
+			const F    diff   = Abs(expected - actual);
+			const F    scale  = Abs(expected) < Abs(actual) ? Abs(actual) : Abs(expected);
+			const typename FloatTraits<F>::Bits x = OrderedBits(expected), y = OrderedBits(actual);
+			return (expected == actual)
+				 | (IsNan(expected) & IsNan(actual) & nanEqual)
+				 | (finite & ((diff <= absolute) | (diff <= relative * scale) | ((x < y ? y - x : x - y) <= ulps)));
+		}
+	};
+
+	struct ArrayComparison // summary of all the elements which failed, rather than just the first
+	{
+		size_type          failures, worstIndex;
+		double             worstExpected, worstActual, maxError;
+		unsigned long long worstUlps;
+	};
+	template <typename F> ArrayComparison CompareArrays(const F* expected, const F* actual, size_type count, const Tolerance& t)
+	{
+		ArrayComparison result = { 0, 0, 0, 0, 0, 0 };
+		const ElementTolerance<F> tolerance(t);
+		const size_type blockSize = 16;
+		for (size_type block = 0; block < count; block += blockSize)
+		{
+			const F* e = expected + block;
+			const F* a = actual   + block;
+			const size_type n = count - block < blockSize ? count - block : blockSize;
+
+			if (n == blockSize) // fast path: a fixed-length, branch-free loop which compilers turn into SIMD code
+			{
+				unsigned int bad = 0;
+				for (size_type i = 0; i < blockSize; ++i)
+					bad += !tolerance.IsClose(e[i], a[i]);
+				if (bad == 0)
+					continue;
+			}
+
+			for (size_type i = 0; i < n; ++i) // slow path: only for blocks containing a failure (and the tail)
+			{
+				if (tolerance.IsClose(e[i], a[i]))
+					continue;
+				const double error = Abs(double(e[i]) - double(a[i])); // NaN if either is NaN; NaN is always the worst
+				if (++result.failures == 1 || (!IsNan(result.maxError) && !(error <= result.maxError)))
+				{
+					result.worstIndex    = block + i;
+					result.worstExpected = e[i];
+					result.worstActual   = a[i];
+					result.maxError      = error;
+					result.worstUlps     = UlpDistance(e[i], a[i]);
+				}
+			}
+		}
+		return result;
+	}
+}
+
+// what to do when an assertion fails: TddAssert()/Assert:: throw, TddExpect()/Expect:: record the failure and carry on
+enum FailureAction { ThrowOnFailure, RecordAndContinue };
+
 template<class string> class AssertException : public TddException
 {
 	const string m_message, m_file;
+	const FailureAction m_action;
 	AssertException(unsigned long line, _In_z_ const char* file, const string& cs)
 		: TDD::TddException(line, "")
 		, m_message(cs)
 		, m_file(file)
+		, m_action(ThrowOnFailure)
 	{
 		SetFile   (ToAsciiz(m_file));
 		SetMessage(ToAsciiz(m_message));
 	}
 public:
-	AssertException(unsigned long line, _In_z_ const char* file)
+	AssertException(unsigned long line, _In_z_ const char* file, FailureAction action = ThrowOnFailure)
 		: TDD::TddException(line, "")
 		, m_file(file)
+		, m_action(action)
 	{
 		SetFile(ToAsciiz(m_file));
 	}
 	virtual ~AssertException() {}
-	void ThrowAssertException(const string& cs) const
+	void ThrowAssertException(const string& cs) const // returns (having recorded the failure) if the action is RecordAndContinue
 	{
+		if (m_action == RecordAndContinue) {
+			Verifier::Record(GetLine(), GetFile(), ToAsciiz(cs));
+			return;
+		}
 		throw AssertException(GetLine(), GetFile(), cs); // throwing a copy
 	}
 private:
@@ -58,7 +190,7 @@ private:
 };
 template<class string> struct StatelessAssertUtils : AssertException<string>
 {
-	StatelessAssertUtils(unsigned long line, _In_z_ const char* file) : AssertException<string>(line, file) {}
+	StatelessAssertUtils(unsigned long line, _In_z_ const char* file, FailureAction action = ThrowOnFailure) : AssertException<string>(line, file, action) {}
 	template <typename S, typename T> void AreEqual(const S& expected, const T& actual, const string& message=string()) const
 	{
 		string csExpected = ToString<string>(expected);
@@ -104,6 +236,24 @@ template<class string> struct StatelessAssertUtils : AssertException<string>
 			AssertException<string>::ThrowAssertException(cs);
 		}
 	}
+
+	template <typename F> void IsWithin(const F* expected, const F* actual, Details::size_type count, const Tolerance& tolerance, const string& message=string()) const
+	{
+		const Details::ArrayComparison c = Details::CompareArrays(expected, actual, count, tolerance);
+		if (c.failures != 0)
+		{
+			string cs = ToString<string>((unsigned long long)c.failures) + " of " + ToString<string>((unsigned long long)count) + " elements differ; worst at index <"
+			          + ToString<string>((unsigned long long)c.worstIndex) + ">: expected <" + ToString<string>(c.worstExpected) + "> actual <" + ToString<string>(c.worstActual)
+			          + "> (error <" + ToString<string>(c.maxError) + ">, <" + ToString<string>(c.worstUlps) + "> ulps); tolerance <abs " + ToString<string>(tolerance.GetAbsolute())
+			          + ", rel " + ToString<string>(tolerance.GetRelative()) + ", ulps " + ToString<string>(tolerance.GetUlps()) + ">";
+			if (!IsEmpty(message))
+			{
+				cs += " - ";
+				cs += message;
+			}
+			AssertException<string>::ThrowAssertException(cs);
+		}
+	}
 };
 template<typename T, class string> class StatefulAssertUtils: public StatelessAssertUtils<string>
 {
@@ -173,13 +323,14 @@ template<class string> class AssertT
 {
 	const StatelessAssertUtils<string> m_utils; // using containment, rather than inheritance, so that IntelliSense works better
 public:
-	AssertT(unsigned long line, _In_z_ const char* file) : m_utils(line, file) {}
+	AssertT(unsigned long line, _In_z_ const char* file, FailureAction action = ThrowOnFailure) : m_utils(line, file, action) {}
 
 	template <typename S, typename T> void AreEqual   (const S& expected, const T& actual, const string& message=string()) { m_utils.AreEqual   (expected, actual, message); }
 	template <typename S, typename T> void AreNotEqual(const S& expected, const T& actual, const string& message=string()) { m_utils.AreNotEqual(expected, actual, message); }
 	template <            typename T> void IsFalse    (                   const T& actual, const string& message=string()) { m_utils.AreEqual   (false,    actual, message); }
 	template <            typename T> void IsTrue     (                   const T& actual, const string& message=string()) { m_utils.AreEqual   ( true,    actual, message); }
 						     void IsWithin(double expected, double actual, double epsilon, const string& message=string()) { m_utils.IsWithin(expected, actual, epsilon, message); }
+	template <typename F> void IsWithin(const F* expected, const F* actual, Details::size_type count, const Tolerance& tolerance, const string& message=string()) { m_utils.IsWithin(expected, actual, count, tolerance, message); }
 	                                  void Fail       (                                    const string& message         ) { m_utils.ThrowAssertException( string(message)); }
 
 
@@ -204,7 +355,7 @@ public:
 
 		try { l(); }
 		catch(const E&) { return; }
-		catch(...) { m_utils.ThrowAssertException("exception of wrong type thrown" + AddMoreText(m)); }
+		catch(...) { m_utils.ThrowAssertException("exception of wrong type thrown" + AddMoreText(m)); return; }
 		m_utils.ThrowAssertException("no exception thrown" + AddMoreText(m));
  	}
 
@@ -217,9 +368,11 @@ public:
 	template <            typename T, typename W> void IsFalse    (                   const T& actual, const W& message) { IsFalse    (          actual, ToString<string>(message)); }
 	template <                        typename W> void Fail       (                                    const W& message) { Fail       (                  ToString<string>(message)); }
 	template <typename E, typename L, typename W> void ExpectingException(L l,                         const W& message) { ExpectingException<E>(l,      ToString<string>(message)); }
+	template <typename F,             typename W> void IsWithin(const F* expected, const F* actual, Details::size_type count, const Tolerance& tolerance, const W& message) { IsWithin(expected, actual, count, tolerance, ToString<string>(message)); }
 };
 
 }
+TDD_LIBRARY_LOCAL_END
 
 #ifdef TDD_DEFINED_SAL_MACROS
  #undef _In_
@@ -0,0 +1,350 @@
+#ifndef TDDASYNC_H
+#define TDDASYNC_H
+
+// Asynchronous test methods, whose bodies are C++20 coroutines:
+//
+//	TEST_METHOD_ASYNC(ServerReplies)
+//	{
+//		std::future<int> reply = std::async(std::launch::async, AskTheServer);
+//		co_await TDD::Async::Delay(std::chrono::milliseconds(10));
+//		Assert::AreEqual(42, co_await TDD::Async::Ready(reply));
+//	}
+//
+// While such a test waits, the runner goes on to start its test class's other tests, and then resumes each waiting test
+// from a single-threaded event loop as what it's waiting for happens. Each test gets its own instance of the test class,
+// TestCleanup runs after the test has finished, and failures are attributed to the right test, before or after a co_await.
+//
+// A test may co_await the awaitables below, and Task<>s (coroutines of its own which co_await them); anything else must
+// resume the test on the runner's thread.
+
+#ifdef TDD_NO_HEAP
+ #error tddAsync.h needs the heap: each waiting test keeps an instance of its test class, and its coroutine frame
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+ #include <poll.h>
+#endif
+
+#include "tdd.h"
+
+TDD_LIBRARY_LOCAL_BEGIN
+namespace TDD { namespace Async {
+
+class Test // what a TEST_METHOD_ASYNC returns
+{
+public:
+	struct promise_type
+	{
+		std::exception_ptr m_exception;
+
+		Test get_return_object() { return Test(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; } // Start() runs it, once it's ready to be resumed
+		std::suspend_always final_suspend()   noexcept { return {}; } // it's destroyed by its TestRun
+		void return_void() {}
+	#ifdef _CPPUNWIND
+		void unhandled_exception() { m_exception = std::current_exception(); }
+	#else
+		void unhandled_exception() { std::terminate(); }
+	#endif
+	};
+
+	Test(Test&& t) noexcept : m_h(std::exchange(t.m_h, nullptr)) {}
+	~Test() { if (m_h) m_h.destroy(); }
+	std::coroutine_handle<promise_type> Release() { return std::exchange(m_h, nullptr); }
+
+private:
+	explicit Test(std::coroutine_handle<promise_type> h) : m_h(h) {}
+	std::coroutine_handle<promise_type> m_h;
+};
+
+class TestRun : public SuspendedTest // a TEST_METHOD_ASYNC which has started
+{
+	std::coroutine_handle<Test::promise_type> m_test;
+	std::coroutine_handle<>                   m_ready; // where to carry on from (which may be in a Task it's awaiting), once it can
+public:
+	explicit TestRun(std::coroutine_handle<Test::promise_type> test) : m_test(test), m_ready(test) {}
+	~TestRun() { m_test.destroy(); }
+
+	TDD_LIBRARY_LOCAL static TestRun*& Current() // the one that's running, and so the one that's about to wait for something
+	{
+		static TestRun * s_run = nullptr;
+		return s_run;
+	}
+	void Continue(std::coroutine_handle<> h) { m_ready = h; } // what it's waiting for has happened
+
+public: // SuspendedTest
+	bool Done() const override { return m_test.done(); }
+	bool Ready() const override { return m_ready != nullptr; }
+	void Resume() override
+	{
+		if (!m_ready)
+			return;
+		TestRun* outer = std::exchange(Current(), this);
+		std::exchange(m_ready, nullptr).resume();
+		Current() = outer;
+	#ifdef _CPPUNWIND
+		if (m_test.done() && m_test.promise().m_exception)
+			std::rethrow_exception(m_test.promise().m_exception);
+	#endif
+	}
+private:
+	TestRun(const TestRun&) = delete;
+	TestRun& operator=(const TestRun&) = delete;
+};
+
+// All waiting is done here, on the runner's thread: timers, polled conditions, and (except on Windows) file descriptors.
+class Loop : public EventLoop
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Waiter
+	{
+		TestRun*                run;
+		std::coroutine_handle<> h;
+		void Wake() const { run->Continue(h); }
+	};
+	std::multimap<Clock::time_point, Waiter>              m_timers;
+	std::vector<std::pair<std::function<bool()>, Waiter>> m_conditions;
+#ifndef _WIN32
+	std::vector<pollfd>                                   m_fds;
+	std::vector<Waiter>                                   m_fdWaiters; // in the same order as m_fds
+#endif
+
+	static Waiter Current(std::coroutine_handle<> h) { return Waiter{ TestRun::Current(), h }; }
+
+	bool Empty() const
+	{
+	#ifndef _WIN32
+		if (!m_fds.empty())
+			return false;
+	#endif
+		return m_timers.empty() && m_conditions.empty();
+	}
+	bool PollConditions() // wakes those which are now true; true if any were
+	{
+		bool woken = false;
+		for (size_t i = 0; i < m_conditions.size(); ) {
+			if (m_conditions[i].first()) {
+				m_conditions[i].second.Wake();
+				m_conditions.erase(m_conditions.begin() + static_cast<std::ptrdiff_t>(i));
+				woken = true;
+			} else {
+				++i;
+			}
+		}
+		return woken;
+	}
+
+public:
+	TDD_LIBRARY_LOCAL static Loop& Instance()
+	{
+		static Loop s_loop;
+		return s_loop;
+	}
+
+	void At  (Clock::time_point when, std::coroutine_handle<> h)       { m_timers.emplace(when, Current(h)); }
+	void When(std::function<bool()> ready, std::coroutine_handle<> h) { m_conditions.emplace_back(std::move(ready), Current(h)); }
+#ifndef _WIN32
+	void OnFd(int fd, short events, std::coroutine_handle<> h)
+	{
+		m_fds.push_back(pollfd{ fd, events, 0 });
+		m_fdWaiters.push_back(Current(h));
+	}
+#endif
+
+public: // EventLoop
+	bool Wait() override
+	{
+		if (Empty())
+			return false;
+
+		// how long can we sleep for? until the next timer, but only a moment if there are conditions to keep polling
+		const bool ready = PollConditions();
+		const int pollingMs = 1;
+		int timeoutMs = -1;
+		if (!m_timers.empty()) {
+			const auto until = std::chrono::ceil<std::chrono::milliseconds>(m_timers.begin()->first - Clock::now()).count();
+			timeoutMs = until < 0 ? 0 : (until > 60000 ? 60000 : static_cast<int>(until));
+		}
+		if (ready)
+			timeoutMs = 0;
+		else if (!m_conditions.empty() && (timeoutMs < 0 || timeoutMs > pollingMs))
+			timeoutMs = pollingMs;
+
+	#ifndef _WIN32
+		if (!m_fds.empty()) {
+			if (poll(m_fds.data(), static_cast<nfds_t>(m_fds.size()), timeoutMs) > 0) {
+				for (size_t i = 0; i < m_fds.size(); ) {
+					if (m_fds[i].revents != 0) {
+						m_fdWaiters[i].Wake();
+						m_fds      .erase(m_fds      .begin() + static_cast<std::ptrdiff_t>(i));
+						m_fdWaiters.erase(m_fdWaiters.begin() + static_cast<std::ptrdiff_t>(i));
+					} else {
+						++i;
+					}
+				}
+			}
+		} else
+	#endif
+		if (timeoutMs > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		}
+
+		const auto now = Clock::now();
+		while (!m_timers.empty() && m_timers.begin()->first <= now) {
+			m_timers.begin()->second.Wake();
+			m_timers.erase(m_timers.begin());
+		}
+		PollConditions();
+		return true;
+	}
+};
+
+// runs the test until it first waits; if it does, it's left for the runner to finish (see SuspendedTest in tdd.h)
+inline void Start(Test test)
+{
+	std::unique_ptr<TestRun> run(new TestRun(test.Release()));
+	run->Resume(); // an exception from here is reported as for any other test
+	if (run->Done())
+		return;
+	EventLoop::Current()     = &Loop::Instance();
+	SuspendedTest::Started() = run.release();
+}
+
+// the awaitables
+
+template<class Rep, class Period> auto Delay(std::chrono::duration<Rep, Period> duration)
+{
+	struct Awaiter
+	{
+		std::chrono::steady_clock::time_point when;
+		bool await_ready() const { return std::chrono::steady_clock::now() >= when; }
+		void await_suspend(std::coroutine_handle<> h) { Loop::Instance().At(when, h); }
+		void await_resume() {}
+	};
+	return Awaiter{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration) };
+}
+
+inline auto Until(std::function<bool()> ready) // polled by the loop, so keep it cheap
+{
+	struct Awaiter
+	{
+		std::function<bool()> ready;
+		bool await_ready() const { return ready(); }
+		void await_suspend(std::coroutine_handle<> h) { Loop::Instance().When(std::move(ready), h); }
+		void await_resume() {}
+	};
+	return Awaiter{ std::move(ready) };
+}
+
+template<class Future> auto Ready(Future& future) // std::future or std::shared_future: waits for it, then co_await returns its get()
+{
+	struct Awaiter
+	{
+		Future& future;
+		bool await_ready() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			Future* f = &future;
+			Loop::Instance().When([f]() { return f->wait_for(std::chrono::seconds(0)) == std::future_status::ready; }, h);
+		}
+		decltype(auto) await_resume() { return future.get(); }
+	};
+	return Awaiter{ future };
+}
+
+#ifndef _WIN32
+inline auto Readable(int fd, short events = POLLIN) // e.g. a socket to a local stand-in for a service
+{
+	struct Awaiter
+	{
+		int fd;
+		short events;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { Loop::Instance().OnFd(fd, events, h); }
+		void await_resume() {}
+	};
+	return Awaiter{ fd, events };
+}
+inline auto Writable(int fd) { return Readable(fd, POLLOUT); }
+#endif
+
+// Task<T>: a coroutine which a test (or another Task) can co_await, for factoring out steps which wait
+namespace Details
+{
+	struct TaskPromiseBase
+	{
+		std::coroutine_handle<> m_continuation;
+		std::exception_ptr      m_exception;
+
+		struct FinalAwaiter // carries on with whoever co_awaited the Task
+		{
+			bool await_ready() noexcept { return false; }
+			template<class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept { return h.promise().m_continuation; }
+			void await_resume() noexcept {}
+		};
+		std::suspend_always initial_suspend() noexcept { return {}; } // it starts when it's co_awaited
+		FinalAwaiter        final_suspend()   noexcept { return {}; }
+	#ifdef _CPPUNWIND
+		void unhandled_exception() { m_exception = std::current_exception(); }
+		void Rethrow() { if (m_exception) std::rethrow_exception(m_exception); }
+	#else
+		void unhandled_exception() { std::terminate(); }
+		void Rethrow() {}
+	#endif
+	};
+	template<class T> struct TaskPromise : TaskPromiseBase
+	{
+		std::optional<T> m_value;
+		void return_value(T value) { m_value.emplace(std::move(value)); }
+		T Result() { Rethrow(); return std::move(*m_value); }
+	};
+	template<> struct TaskPromise<void> : TaskPromiseBase
+	{
+		void return_void() {}
+		void Result() { Rethrow(); }
+	};
+}
+
+template<class T = void> class Task
+{
+public:
+	struct promise_type : Details::TaskPromise<T>
+	{
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	Task(Task&& t) noexcept : m_h(std::exchange(t.m_h, nullptr)) {}
+	~Task() { if (m_h) m_h.destroy(); }
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+	{
+		m_h.promise().m_continuation = continuation;
+		return m_h;
+	}
+	T await_resume() { return m_h.promise().Result(); }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> h) : m_h(h) {}
+	std::coroutine_handle<promise_type> m_h;
+};
+
+}} // namespace TDD::Async
+TDD_LIBRARY_LOCAL_END
+
+#define TEST_METHOD_ASYNC(methodName) TESTMETHOD(methodName) { ::TDD::Async::Start(methodName##_async_test_method()); } ::TDD::Async::Test methodName##_async_test_method()
+
+#endif
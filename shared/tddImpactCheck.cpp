@@ -0,0 +1,58 @@
+// Checks that PortableRunner --record-impact copes with instrumented code which uses the standard library: the tests
+// below lock a std::mutex, grow a std::vector and read a std::atomic, and -finstrument-functions gives this file its own
+// (instrumented) copies of those inline functions, which the linker picks over the runner's when this comes first. The
+// hooks mustn't call any of them. It has no main: it's linked into a runner built with the hooks, and run to record, then
+// to select:
+//
+//     g++ -std=c++17 -g -O0 -finstrument-functions -D_CPPUNWIND '-D__pragma(x)=' -c shared/tddImpactCheck.cpp
+//     g++ -std=c++17 -g -DTDD_IMPACT_HOOKS -D_CPPUNWIND '-D__pragma(x)=' -c PortableRunner/PortableRunner.cpp
+//     g++ -rdynamic tddImpactCheck.o PortableRunner.o -o tddImpactCheck -ldl -lpthread
+//     ./tddImpactCheck --record-impact && echo shared/tddImpactCheck.cpp | ./tddImpactCheck --changed=-
+//
+// Both runs should pass both tests (not overflow the stack, or deadlock), and the second should say that the file
+// impacts the tests and their class.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tdd.h"
+
+namespace ImpactCheck
+{
+    class Log
+    {
+        std::mutex       m_mutex;
+        std::vector<int> m_entries;
+        std::atomic<int> m_count{ 0 };
+    public:
+        void Add(int entry)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_entries.push_back(entry);
+            ++m_count;
+        }
+        int Count() const { return m_count.load(); }
+    };
+
+    TEST_CLASS(WithTheStandardLibrary)
+    {
+        Log m_log;
+    public:
+        TEST_METHOD(LocksAndGrows)
+        {
+            for (int i = 0; i < 100; ++i)
+                m_log.Add(i);
+            TDD_VERIFY_EQUAL(100, m_log.Count());
+        }
+        TEST_METHOD(LocksOnAnotherThread) // which the hooks record too, without a lock of their own
+        {
+            std::thread other([this]() { for (int i = 0; i < 100; ++i) m_log.Add(i); });
+            for (int i = 0; i < 100; ++i)
+                m_log.Add(i);
+            other.join();
+            TDD_VERIFY_EQUAL(200, m_log.Count());
+        }
+    };
+}
@@ -0,0 +1,530 @@
+#ifndef TDDMOCK_H
+#define TDDMOCK_H
+
+// Mocks of virtual interfaces, for testing the code which calls them:
+//
+//	struct MockStore : IStore
+//	{
+//		TDD_MOCK_METHOD2(bool, Put, int, const std::string&);
+//		TDD_MOCK_CONST_METHOD1(int, Get, int);
+//	};
+//
+//	TEST_METHOD(SavesEachRecordOnce)
+//	{
+//		MockStore store;
+//		TDD_EXPECT_CALL(store, Put).With(1, TDD::Any()).Returns(true);
+//		TDD_EXPECT_CALL(store, Put).With(TDD::Gt(1), TDD::Any()).Times(2).Returns(true);
+//		TDD_EXPECT_CALL(store, Get).Never();
+//		Save(store, records);
+//	}
+//
+// A call is matched against its method's expectations, the latest first (so a narrower expectation can follow a
+// catch-all), and the one it matches gives the result: Returns, or Does to call something instead, or by default a
+// value-initialized one. A call which matches none of its method's expectations, or matches one which has already been
+// called as often as it allows, fails there and then (at the latest expectation, or the one it matched); a method without
+// expectations may be called any number of times.
+// The number of calls is verified when the test has finished: after TestCleanup, for mocks which are members of the test
+// class, or as they're destroyed, for those in the test method. A mock belongs to the test which creates it (or which uses
+// it next, once that test has finished), so a TEST_METHOD_ASYNC's mocks are verified when it finishes, not when another
+// test does while it waits; a mock made outside any test (e.g., by TestClassInitialize, for several tests to share) is
+// only verified as it's destroyed. The failures go through TddAssert's AssertT, like any other assertion's.
+//
+// Calls are recorded, with copies of their arguments (where they can be copied), for checking afterwards instead:
+//
+//		Assert::AreEqual(3u, store.Put_mock.Count());
+//		Assert::AreEqual(2,  std::get<0>(store.Put_mock.Call(1))); // the key given to the second call
+//
+// The expectations and the recorded calls go into an arena for each test, which is emptied after the test but keeps its
+// memory for the next, so that once it's grown to fit the tests, recording a call itself doesn't allocate. Copying the
+// arguments still may: a std::string (which a const std::string& argument is copied to) allocates if it's longer than
+// fits in the string itself, as does a std::vector that isn't empty. Mock those methods with arguments that aren't
+// recorded (ones which can't be copied) where that matters. A mock is called on one thread at a time.
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "tdd.h"
+#include "TddAssertStl.h"
+
+#ifndef TDD_MOCK_ARENA_BLOCK
+ #define TDD_MOCK_ARENA_BLOCK 65536 // bytes in each of the arena's blocks; it adds blocks as a test needs them
+#endif
+
+TDD_LIBRARY_LOCAL_BEGIN
+namespace TDD
+{
+
+class MockArena
+{
+	struct Block
+	{
+		Block* next;
+		size_t size;
+		size_t used;
+		char* Data() { return reinterpret_cast<char*>(this) + Header(); }
+		static size_t Header() { return (sizeof(Block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t); }
+	};
+	struct Destructor // for an object which needs destroying when the arena's emptied
+	{
+		void      (*destroy)(void*);
+		void*       object;
+		Destructor* next;
+	};
+	Block*      m_first;
+	Block*      m_current;     // the one being filled; those after it are empty
+	Destructor* m_destructors; // the latest first
+
+	template<typename T> static void Destroy(void* p) { static_cast<T*>(p)->~T(); }
+
+	void* Allocate(size_t size, size_t alignment)
+	{
+		for (;;) {
+			if (m_current) {
+				const size_t offset = (m_current->used + alignment - 1) / alignment * alignment;
+				if (offset + size <= m_current->size) {
+					m_current->used = offset + size;
+					return m_current->Data() + offset;
+				}
+				if (m_current->next) {
+					m_current = m_current->next;
+					continue;
+				}
+			}
+			const size_t capacity = size > TDD_MOCK_ARENA_BLOCK ? size : TDD_MOCK_ARENA_BLOCK;
+			Block* b = static_cast<Block*>(::operator new(Block::Header() + capacity));
+			b->next = 0;
+			b->size = capacity;
+			b->used = 0;
+			if (m_current)
+				m_current->next = b;
+			else
+				m_first = b;
+			m_current = b;
+		}
+	}
+	MockArena() : m_first(0), m_current(0), m_destructors(0) {}
+	~MockArena()
+	{
+		Empty();
+		while (m_first) {
+			Block* b = m_first;
+			m_first = b->next;
+			::operator delete(b);
+		}
+	}
+	MockArena(const MockArena&);
+	MockArena& operator=(const MockArena&);
+	friend class MockMethodBase; // which keeps one for each test
+public:
+	template<typename T, typename... A> T* New(A&&... a)
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t), "the mock arena doesn't over-align");
+		T* t = new (Allocate(sizeof(T), alignof(T))) T(std::forward<A>(a)...);
+		if (!std::is_trivially_destructible<T>::value) {
+			Destructor* d = new (Allocate(sizeof(Destructor), alignof(Destructor))) Destructor;
+			d->destroy = &Destroy<T>;
+			d->object = t;
+			d->next = m_destructors;
+			m_destructors = d;
+		}
+		return t;
+	}
+	// destroys everything in it, keeping the blocks
+	void Empty()
+	{
+		for (Destructor* d = m_destructors; d; d = d->next)
+			d->destroy(d->object);
+		m_destructors = 0;
+		for (Block* b = m_first; b; b = b->next)
+			b->used = 0;
+		m_current = m_first;
+	}
+};
+
+// argument matchers, for With; any other value given to With matches arguments equal to it
+struct MockMatcher {};
+namespace Details
+{
+	struct MatchAny      { template<typename A, typename T> static bool Is(const A&,   const T&)   { return true;    } };
+	struct MatchEqual    { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a == t;  } };
+	struct MatchNotEqual { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a != t;  } };
+	struct MatchLess     { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a <  t;  } };
+	struct MatchAtMost   { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a <= t;  } };
+	struct MatchGreater  { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a >  t;  } };
+	struct MatchAtLeast  { template<typename A, typename T> static bool Is(const A& a, const T& t) { return a >= t;  } };
+	struct MatchWhere    { template<typename A, typename P> static bool Is(const A& a, const P& p) { return p(a) ? true : false; } };
+}
+template<typename Op, typename T> struct MockCompare : MockMatcher
+{
+	T value;
+	explicit MockCompare(const T& t) : value(t) {}
+	template<typename A> bool operator()(const A& a) const { return Op::Is(a, value); }
+};
+inline                       MockCompare<Details::MatchAny,      int> Any()               { return MockCompare<Details::MatchAny,      int>(0); }
+template<typename T> inline MockCompare<Details::MatchEqual,    T>   Eq(const T& t)      { return MockCompare<Details::MatchEqual,    T>(t); }
+template<typename T> inline MockCompare<Details::MatchNotEqual, T>   Ne(const T& t)      { return MockCompare<Details::MatchNotEqual, T>(t); }
+template<typename T> inline MockCompare<Details::MatchLess,     T>   Lt(const T& t)      { return MockCompare<Details::MatchLess,     T>(t); }
+template<typename T> inline MockCompare<Details::MatchAtMost,   T>   Le(const T& t)      { return MockCompare<Details::MatchAtMost,   T>(t); }
+template<typename T> inline MockCompare<Details::MatchGreater,  T>   Gt(const T& t)      { return MockCompare<Details::MatchGreater,  T>(t); }
+template<typename T> inline MockCompare<Details::MatchAtLeast,  T>   Ge(const T& t)      { return MockCompare<Details::MatchAtLeast,  T>(t); }
+template<typename P> inline MockCompare<Details::MatchWhere,    P>   Where(const P& p)   { return MockCompare<Details::MatchWhere,    P>(p); } // p(argument) is true
+
+namespace Details
+{
+	template<typename M, bool = std::is_base_of<MockMatcher, M>::value> struct ToMatcher           { typedef M Type; };
+	template<typename T>                                                struct ToMatcher<T, false> { typedef MockCompare<MatchEqual, typename std::decay<const T>::type> Type; };
+
+	template<typename... M> struct MatcherList
+	{
+		bool Match() const { return true; }
+	};
+	template<typename M, typename... Rest> struct MatcherList<M, Rest...>
+	{
+		M                     first;
+		MatcherList<Rest...>  rest;
+		template<typename X, typename... Xs> explicit MatcherList(const X& x, const Xs&... xs) : first(x), rest(xs...) {} // matchers, or values to equal
+		template<typename A, typename... As> bool Match(const A& a, const As&... as) const { return first(a) && rest.Match(as...); }
+	};
+
+	template<typename R> struct MockDefault    { static R Value() { return R(); } };
+	template<>           struct MockDefault<void> { static void Value() {} };
+	template<typename R> struct MockDefault<R&> // a value-initialized one, for each type
+	{
+		static R& Value() { static typename std::remove_const<R>::type s_value = typename std::remove_const<R>::type(); return s_value; }
+	};
+
+	template<typename... A> struct AllCopyable;
+	template<>              struct AllCopyable<> { enum { value = true }; };
+	template<typename A, typename... Rest> struct AllCopyable<A, Rest...>
+	{
+		enum { value = std::is_copy_constructible<typename std::decay<A>::type>::value && AllCopyable<Rest...>::value };
+	};
+	// copies of the arguments, or nothing if some can't be copied
+	template<bool copyable, typename... A> struct MockArguments            { typedef std::tuple<typename std::decay<A>::type...> Type; static Type Of(const A&... a) { return Type(a...); } };
+	template<typename... A>                struct MockArguments<false, A...> { typedef std::tuple<>                                Type; static Type Of(const A&...)     { return Type(); } };
+}
+
+class MockMethodBase
+{
+	MockMethodBase*     m_previous; // in the list of those in existence
+	MockMethodBase*     m_next;
+	const UnitTestInfo* m_owner;    // the test which verifies it as it finishes, or 0 for none
+	MockArena*          m_arena;    // its owner's
+	bool                m_verified; // if so, what was in the arena has gone
+
+	class Registry : public TestCleanupCheck
+	{
+		struct Owned // an arena, and the test it's for (or 0, for the mocks which no test owns)
+		{
+			const UnitTestInfo* test;
+			MockArena           arena;
+			Owned*              next;
+		};
+		MockMethodBase* m_first;
+		Owned*          m_arenas; // in use
+		Owned*          m_free;   // emptied, for the next tests
+		unsigned int    m_unowned; // mocks which no test owns: their arena is emptied once there are none
+
+		Registry() : m_first(0), m_arenas(0), m_free(0), m_unowned(0) {}
+		static void Delete(Owned* list)
+		{
+			while (list) {
+				Owned* o = list;
+				list = o->next;
+				delete o;
+			}
+		}
+		~Registry()
+		{
+			Delete(m_arenas);
+			Delete(m_free);
+		}
+		MockArena& ArenaOf(const UnitTestInfo* test)
+		{
+			for (Owned* o = m_arenas; o; o = o->next)
+				if (o->test == test)
+					return o->arena;
+			Owned* o = m_free ? m_free : new Owned();
+			if (m_free)
+				m_free = m_free->next;
+			o->test = test;
+			o->next = m_arenas;
+			m_arenas = o;
+			return o->arena;
+		}
+		void Release(const UnitTestInfo* test) // empties its arena
+		{
+			for (Owned** p = &m_arenas; *p; p = &(*p)->next)
+				if ((*p)->test == test) {
+					Owned* o = *p;
+					*p = o->next;
+					o->arena.Empty();
+					o->next = m_free;
+					m_free = o;
+					return;
+				}
+		}
+	public:
+		void Own(MockMethodBase& m) // by the test which is running
+		{
+			m.m_owner = TestCleanupCheck::Running();
+			m.m_arena = &ArenaOf(m.m_owner);
+			m_unowned += m.m_owner ? 0 : 1;
+		}
+		void Disown(MockMethodBase& m)
+		{
+			if (!m.m_owner && --m_unowned == 0)
+				Release(0);
+		}
+		void Add(MockMethodBase& m)
+		{
+			m.m_next = m_first;
+			if (m_first)
+				m_first->m_previous = &m;
+			m_first = &m;
+			Own(m);
+		}
+		void Remove(MockMethodBase& m)
+		{
+			(m.m_previous ? m.m_previous->m_next : m_first) = m.m_next;
+			if (m.m_next)
+				m.m_next->m_previous = m.m_previous;
+			Disown(m);
+		}
+		void Check(const UnitTestInfo& test) override
+		{
+			std::string failures;
+			unsigned long line = 0;
+			const char* file = "";
+			for (MockMethodBase* m = m_first; m; m = m->m_next)
+				if (m->m_owner == &test && !m->m_verified) {
+					m->Verify(failures, line, file);
+					m->m_verified = true;
+				}
+			Release(&test);
+			if (!failures.empty())
+				AssertT<std::string>(line, file).Fail(failures);
+		}
+		static Registry& Current()
+		{
+			static Registry s_registry;
+			TestCleanupCheck::Current() = &s_registry;
+			return s_registry;
+		}
+	};
+	MockMethodBase(const MockMethodBase&);
+	MockMethodBase& operator=(const MockMethodBase&);
+
+protected:
+	const char* const   m_name;
+	const unsigned long m_line; // where it's declared
+	const char* const   m_file;
+
+	MockMethodBase(_In_z_ const char* name, unsigned long line, _In_z_ const char* file) : m_previous(0), m_next(0), m_owner(0), m_arena(0), m_verified(false), m_name(name), m_line(line), m_file(file)
+	{
+		Registry::Current().Add(*this);
+	}
+	// Derived classes call this from their destructors, since it calls Verify
+	void Finish()
+	{
+		Registry::Current().Remove(*this);
+		if (m_verified)
+			return;
+		m_verified = true;
+		std::string failures;
+		unsigned long line = 0;
+		const char* file = "";
+		Verify(failures, line, file);
+		if (!failures.empty())
+			AssertT<std::string>(line, file, RecordAndContinue).Fail(failures); // a destructor mustn't throw
+	}
+	bool Renew() // true if it's been verified, so that what it had in the arena has gone (after its test): then it's the running test's
+	{
+		const bool verified = m_verified;
+		if (verified) {
+			Registry::Current().Disown(*this);
+			Registry::Current().Own(*this);
+		}
+		m_verified = false;
+		return verified;
+	}
+	MockArena& Arena() const { return *m_arena; }
+	// adds a description of each expectation which hasn't been met to failures (and, for the first, its line and file)
+	virtual void Verify(std::string& failures, unsigned long& line, const char*& file) const = 0;
+public:
+	virtual ~MockMethodBase() {}
+};
+
+template<typename Signature> class MockMethod;
+template<typename R, typename... A> class MockMethod<R(A...)> : public MockMethodBase
+{
+	typedef Details::MockArguments<Details::AllCopyable<A...>::value, A...> Arguments;
+
+	struct Matchers { virtual bool Match(const A&... a) const = 0; };
+	template<typename List> struct MatchersOf : Matchers
+	{
+		List list;
+		explicit MatchersOf(const List& l) : list(l) {}
+		bool Match(const A&... a) const override { return list.Match(a...); }
+	};
+	struct Action { virtual R Do(A... a) = 0; };
+	template<typename F> struct Function : Action
+	{
+		F f;
+		explicit Function(const F& function) : f(function) {}
+		R Do(A... a) override { return f(std::forward<A>(a)...); }
+	};
+	template<typename V> struct Return : Action
+	{
+		V value;
+		explicit Return(const V& v) : value(v) {}
+		R Do(A...) override { return value; }
+	};
+	struct Record
+	{
+		typename Arguments::Type arguments;
+		Record*                  next;
+		explicit Record(const typename Arguments::Type& a) : arguments(a), next(0) {}
+	};
+
+public:
+	class Expectation // one TDD_EXPECT_CALL
+	{
+		friend class MockMethod;
+		MockArena&          m_arena;
+		const unsigned long m_line;
+		const char* const   m_file;
+		Matchers*           m_matchers; // 0 for any arguments
+		Action*             m_action;   // 0 for a value-initialized result
+		unsigned int        m_min, m_max, m_calls;
+		Expectation*        m_next;     // the one set before it
+	public:
+		Expectation(MockArena& arena, unsigned long line, _In_z_ const char* file, Expectation* next) : m_arena(arena), m_line(line), m_file(file), m_matchers(0), m_action(0), m_min(1), m_max(1), m_calls(0), m_next(next) {}
+
+		template<typename... M> Expectation& With(const M&... matchers) // a matcher (or a value to equal) for each argument
+		{
+			static_assert(sizeof...(M) == sizeof...(A), "With needs a matcher for each argument");
+			typedef Details::MatcherList<typename Details::ToMatcher<M>::Type...> List;
+			m_matchers = m_arena.New<MatchersOf<List> >(List(matchers...));
+			return *this;
+		}
+		Expectation& Times  (unsigned int n) { m_min = n; m_max = n; return *this; }
+		Expectation& AtLeast(unsigned int n) { m_min = n; m_max = ~0u; return *this; }
+		Expectation& AtMost (unsigned int n) { m_min = 0; m_max = n; return *this; }
+		Expectation& Never  ()               { return Times(0); }
+		template<typename V> Expectation& Returns(const V& value) // for a reference, to a copy of value (Does can return another)
+		{
+			m_action = m_arena.New<Return<typename std::decay<R>::type> >(value);
+			return *this;
+		}
+		template<typename F> Expectation& Does(const F& function) // function(arguments...) gives the result
+		{
+			m_action = m_arena.New<Function<F> >(function);
+			return *this;
+		}
+	};
+
+	MockMethod(_In_z_ const char* name, unsigned long line, _In_z_ const char* file) : MockMethodBase(name, line, file), m_expectations(0), m_first(0), m_last(0), m_count(0) {}
+	~MockMethod() { Finish(); }
+
+	Expectation& Expect(unsigned long line, _In_z_ const char* file)
+	{
+		Forget();
+		m_expectations = Arena().New<Expectation>(Arena(), line, file, m_expectations);
+		return *m_expectations;
+	}
+
+	R Invoke(A... a)
+	{
+		Forget();
+		Record* r = Arena().New<Record>(Arguments::Of(a...));
+		(m_last ? m_last->next : m_first) = r;
+		m_last = r;
+		++m_count;
+
+		for (Expectation* e = m_expectations; e; e = e->m_next) {
+			if (e->m_matchers && !e->m_matchers->Match(a...))
+				continue;
+			if (e->m_calls == e->m_max)
+				AssertT<std::string>(e->m_line, e->m_file).Fail(std::string(m_name) + " was called more than the " + ToString<std::string>(e->m_max) + " time(s) expected");
+			++e->m_calls;
+			return e->m_action ? e->m_action->Do(std::forward<A>(a)...) : Details::MockDefault<R>::Value();
+		}
+		if (m_expectations) // reported at the latest expectation, since the call itself is somewhere in the code under test
+			AssertT<std::string>(m_expectations->m_line, m_expectations->m_file).Fail("unexpected call to " + std::string(m_name) + ": its arguments match none of its expectations");
+		return Details::MockDefault<R>::Value();
+	}
+
+	unsigned int Count() const { return m_count; } // the calls so far
+	const typename Arguments::Type& Call(unsigned int i) const // the arguments of call i (from 0)
+	{
+		static_assert(std::tuple_size<typename Arguments::Type>::value == sizeof...(A), "the arguments can't be copied, so they weren't recorded");
+		const Record* r = m_first;
+		for (; r && i > 0; --i)
+			r = r->next;
+		if (!r)
+			AssertT<std::string>(m_line, m_file).Fail(std::string(m_name) + " wasn't called that many times");
+		return r->arguments;
+	}
+
+private:
+	Expectation*  m_expectations; // the latest first
+	Record*       m_first;
+	Record*       m_last;
+	unsigned int  m_count;
+
+	void Forget() // what it had in the arena, if that's been emptied since
+	{
+		if (!Renew())
+			return;
+		m_expectations = 0;
+		m_first = m_last = 0;
+		m_count = 0;
+	}
+	void Verify(std::string& failures, unsigned long& line, const char*& file) const override
+	{
+		for (const Expectation* e = m_expectations; e; e = e->m_next) {
+			if (e->m_calls >= e->m_min)
+				continue;
+			if (failures.empty()) {
+				line = e->m_line;
+				file = e->m_file;
+			} else {
+				failures += "; ";
+			}
+			failures += std::string(m_name) + " was expected to be called " + (e->m_max == e->m_min ? "" : "at least ") + ToString<std::string>(e->m_min)
+			          + " time(s), but was called " + ToString<std::string>(e->m_calls) + " (expected at " + e->m_file + "(" + ToString<std::string>(e->m_line) + "))";
+		}
+	}
+};
+
+}
+TDD_LIBRARY_LOCAL_END
+
+#define TDD_EXPECT_CALL(mock, name) (mock).name##_mock.Expect(__LINE__, __FILE__)
+
+#define TDD_MOCK_METHOD_(R, name, constness, types, parameters, arguments) \
+	mutable ::TDD::MockMethod<R types> name##_mock{ #name, __LINE__, __FILE__ }; \
+	R name parameters constness override { return name##_mock.Invoke arguments; }
+
+#define TDD_MOCK_METHOD0(R, name)                         TDD_MOCK_METHOD_(R, name, , (),                     (),                                       ())
+#define TDD_MOCK_METHOD1(R, name, A1)                     TDD_MOCK_METHOD_(R, name, , (A1),                   (A1 a1),                                  (std::forward<A1>(a1)))
+#define TDD_MOCK_METHOD2(R, name, A1, A2)                 TDD_MOCK_METHOD_(R, name, , (A1, A2),               (A1 a1, A2 a2),                           (std::forward<A1>(a1), std::forward<A2>(a2)))
+#define TDD_MOCK_METHOD3(R, name, A1, A2, A3)             TDD_MOCK_METHOD_(R, name, , (A1, A2, A3),           (A1 a1, A2 a2, A3 a3),                    (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3)))
+#define TDD_MOCK_METHOD4(R, name, A1, A2, A3, A4)         TDD_MOCK_METHOD_(R, name, , (A1, A2, A3, A4),       (A1 a1, A2 a2, A3 a3, A4 a4),             (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4)))
+#define TDD_MOCK_METHOD5(R, name, A1, A2, A3, A4, A5)     TDD_MOCK_METHOD_(R, name, , (A1, A2, A3, A4, A5),   (A1 a1, A2 a2, A3 a3, A4 a4, A5 a5),      (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4), std::forward<A5>(a5)))
+#define TDD_MOCK_METHOD6(R, name, A1, A2, A3, A4, A5, A6) TDD_MOCK_METHOD_(R, name, , (A1, A2, A3, A4, A5, A6), (A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6), (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4), std::forward<A5>(a5), std::forward<A6>(a6)))
+
+#define TDD_MOCK_CONST_METHOD0(R, name)                         TDD_MOCK_METHOD_(R, name, const, (),                     (),                                       ())
+#define TDD_MOCK_CONST_METHOD1(R, name, A1)                     TDD_MOCK_METHOD_(R, name, const, (A1),                   (A1 a1),                                  (std::forward<A1>(a1)))
+#define TDD_MOCK_CONST_METHOD2(R, name, A1, A2)                 TDD_MOCK_METHOD_(R, name, const, (A1, A2),               (A1 a1, A2 a2),                           (std::forward<A1>(a1), std::forward<A2>(a2)))
+#define TDD_MOCK_CONST_METHOD3(R, name, A1, A2, A3)             TDD_MOCK_METHOD_(R, name, const, (A1, A2, A3),           (A1 a1, A2 a2, A3 a3),                    (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3)))
+#define TDD_MOCK_CONST_METHOD4(R, name, A1, A2, A3, A4)         TDD_MOCK_METHOD_(R, name, const, (A1, A2, A3, A4),       (A1 a1, A2 a2, A3 a3, A4 a4),             (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4)))
+#define TDD_MOCK_CONST_METHOD5(R, name, A1, A2, A3, A4, A5)     TDD_MOCK_METHOD_(R, name, const, (A1, A2, A3, A4, A5),   (A1 a1, A2 a2, A3 a3, A4 a4, A5 a5),      (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4), std::forward<A5>(a5)))
+#define TDD_MOCK_CONST_METHOD6(R, name, A1, A2, A3, A4, A5, A6) TDD_MOCK_METHOD_(R, name, const, (A1, A2, A3, A4, A5, A6), (A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6), (std::forward<A1>(a1), std::forward<A2>(a2), std::forward<A3>(a3), std::forward<A4>(a4), std::forward<A5>(a5), std::forward<A6>(a6)))
+
+#endif
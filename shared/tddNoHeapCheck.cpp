@@ -0,0 +1,67 @@
+// Checks that tdd.h with TDD_NO_HEAP makes no dynamic allocations: replaces operator new with one that counts its calls,
+// registers and runs a few test classes (twice, as a runner rerunning them would), and fails if anything was allocated.
+// It has its own main, so it's built on its own, not in a runner:
+//
+//     cl /std:c++17 shared\tddNoHeapCheck.cpp && tddNoHeapCheck
+//     g++ -std=c++17 -fno-exceptions '-D__pragma(x)=' shared/tddNoHeapCheck.cpp -o tddNoHeapCheck && ./tddNoHeapCheck
+//
+// Its exit code is the number of allocations and failures which weren't expected.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static unsigned int g_allocations = 0;
+void* operator new(std::size_t size) { ++g_allocations; return std::malloc(size ? size : 1); }
+void* operator new[](std::size_t size) { ++g_allocations; return std::malloc(size ? size : 1); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+static const unsigned int g_beforeRegistration = g_allocations; // (initialized before the registrars below, in this file)
+
+#define TDD_NO_HEAP
+#include "tdd.h"
+
+namespace NoHeap
+{
+    struct Table { int values[16]; };
+    static const Table* s_table = 0;
+
+    TEST_CLASS(WithACachedFixture)
+    {
+        int m_value = 7;
+    public:
+        TEST_CLASS_INITIALIZE(Build) { s_table = &TDD_CACHED_FIXTURE(Table, "table", [](Table& t) { t.values[0] = 3; }); }
+        TEST_METHOD(ChangesItsInstance) { TDD_VERIFY(m_value == 7); m_value = 8; }
+        TEST_METHOD(GetsAFreshInstance) { TDD_VERIFY(m_value == 7); }
+        TEST_METHOD(ReadsTheFixture) { TDD_VERIFY(s_table != 0 && s_table->values[0] == 3); }
+        TEST_METHOD(Fails) { TDD_VERIFY_EQUAL(1, 2); } // (a recorded failure mustn't allocate either)
+    };
+}
+
+TEST_CLASS(WithSpans)
+{
+public:
+    TEST_METHOD(Traces) { TDD_TRACE_SPAN("span"); TDD_VERIFY(true); }
+};
+
+struct CountingReporter : public TDD::Reporter
+{
+    unsigned int tests = 0, failures = 0;
+    void ForEachTest(const TDD::UnitTestInfo&) override { ++tests; }
+    void ForEachFailure(const TDD::TestFailure& tf) override { ++failures; printf("%s.%s: %s\n", tf.group, tf.testname, tf.error_string); }
+};
+
+int main()
+{
+    const unsigned int registration = g_allocations - g_beforeRegistration;
+    CountingReporter r;
+    TDD::Discriminator all;
+    TDD::ClassRegistrarBase::RunTests(all, r);
+    TDD::ClassRegistrarBase::RunTests(all, r);
+    const unsigned int run = g_allocations - g_beforeRegistration - registration;
+    printf("%u allocations registering the tests, %u running them twice; %u tests, %u failures (2 expected)\n", registration, run, r.tests, r.failures);
+    return static_cast<int>(registration + run + (r.tests != 10) + (r.failures != 2));
+}
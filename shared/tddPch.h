@@ -0,0 +1,33 @@
+#ifndef TDDPCH_H
+#define TDDPCH_H
+
+// A precompiled header for test projects: most of the time it takes to compile a test file goes on parsing the standard
+// headers, and the framework's, which CppUnitTest.h includes. Precompile this header once per project, and include it
+// first in each test file (or force-include it):
+//	- Visual Studio: Precompiled Header = Use (/Yu"tddPch.h"), and Create (/Yc"tddPch.h") for one .cpp which includes only it
+//	- gcc: g++ <flags> -x c++-header tddPch.h, which writes tddPch.h.gch beside it, for #include "tddPch.h" to pick up
+//	- clang: clang++ <flags> -x c++-header tddPch.h -o tddPch.h.pch, then -include-pch tddPch.h.pch
+// The flags must match those of the test files; in particular, macros which configure the framework (TDD_TEST_LIBRARY,
+// TDD_MAX_RECORDED_FAILURES, TDD_NO_CONSTEXPR_NAMES, TDD_TIMING_*, _CPPUNWIND) belong on the command line, not in a
+// test file, as the precompiled header has already been configured by the time a test file is compiled.
+// Add the headers of the code under test here too, if they rarely change.
+//
+// With C++20 header units, the same goes for import "CppUnitTest.h"; (or, in Visual Studio, Translate Includes to Imports
+// with CppUnitTest.h built as a header unit): unlike a named module, a header unit exports the TEST_* macros too.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <source_location>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+#include "CppUnitTest.h"
+
+#endif
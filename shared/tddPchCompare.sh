@@ -0,0 +1,59 @@
+#!/bin/sh
+# Compares compiling a test file with and without the precompiled header (tddPch.h):
+#
+#	shared/tddPchCompare.sh [test file] [compiler flags...]     (default: shared/SampleTests.cpp; CXX=clang++ by default)
+#
+# prints the wall-clock time of each compile (the best of three), and, with clang, writes a -ftime-trace of each (open them
+# in https://ui.perfetto.dev or chrome://tracing) and prints the time its frontend spent on each. With gcc, which has no
+# -ftime-trace, only the times are printed. The flags are used for the precompiled header and the test file alike.
+
+set -e
+shared=$(cd "$(dirname "$0")" && pwd)
+file=${1:-$shared/SampleTests.cpp}
+[ $# -gt 0 ] && shift
+CXX=${CXX:-clang++}
+out=${TDD_PCH_COMPARE_DIR:-tddPchCompare}
+flags="-std=c++20 -O0 -D_CPPUNWIND $*"
+
+mkdir -p "$out/inc"
+ln -sf "$shared/CppUnitTest.h"  "$out/inc/..\\shared\\CppUnitTest.h" # the tests include "..\shared\CppUnitTest.h",
+ln -sf "$shared/TddAssertStl.h" "$out/inc/tddAssertStl.h"             # and the headers aren't all named as they're included
+cp "$shared/tddPch.h" "$out/tddPch.h"                                # (beside the precompiled header, for gcc to find it)
+
+trace=
+if $CXX -ftime-trace -x c++ -fsyntax-only /dev/null 2>/dev/null; then
+	trace=-ftime-trace
+fi
+
+now() { date +%s%N; }
+best() # the fastest of three runs of a command, in ms
+{
+	fastest=
+	for i in 1 2 3; do
+		start=$(now)
+		"$@"
+		ms=$(( ($(now) - start) / 1000000 ))
+		if [ -z "$fastest" ] || [ "$ms" -lt "$fastest" ]; then
+			fastest=$ms
+		fi
+	done
+	echo "$fastest"
+}
+
+case "$($CXX --version)" in
+	*clang*) pch="$out/tddPch.h.pch"; use="-include-pch $pch" ;;
+	*)       pch="$out/tddPch.h.gch"; use="-include $out/tddPch.h" ;;
+esac
+
+# shellcheck disable=SC2086 # (the flags are meant to be split)
+$CXX $flags -I"$out/inc" -I"$shared" -x c++-header "$shared/tddPch.h" -o "$pch"
+without=$(best $CXX $flags $trace -I"$out/inc" -I"$shared" -c "$file" -o "$out/without.o")
+with=$(best $CXX $flags $trace -I"$out/inc" -I"$shared" $use -c "$file" -o "$out/with.o")
+
+echo "$(basename "$file") with $CXX: $without ms without the precompiled header, $with ms with it"
+if [ -n "$trace" ]; then
+	for t in without with; do
+		frontend=$(grep -o '"name":"Total Frontend"[^}]*"dur":[0-9]*' "$out/$t.json" | grep -o '[0-9]*$' || true)
+		echo "$out/$t.json: frontend ${frontend:-?} us"
+	done
+fi
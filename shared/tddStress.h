@@ -0,0 +1,258 @@
+#ifndef TDDSTRESS_H
+#define TDDSTRESS_H
+
+// Stress tests, for lock-free data structures and the like:
+//
+//	TEST_STRESS(PushAndPop, 8, 100000, TDD::Stress::Options().RandomYields(16).PinThreads())
+//	{
+//		m_queue.Push(thread.index);           // 8 threads, each running this 100000 times, all released together;
+//		TddAssert().IsTrue(m_queue.Pop());    // this is an ordinary test method of the test class, so its constructor
+//	}                                         // and TestInitialize/TestCleanup run once, around the whole stress test
+//
+// The options are optional. The first failure (on any thread) stops all the threads, and is reported with the thread and
+// iteration it happened on; each thread's throughput is reported as a message (see Reporter::ForEachMessage). Without
+// exceptions, a failure can't end its iteration, so the threads stop once it's over, and any recorded failure (Expect::
+// too) counts as the first.
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif defined(__linux__)
+ #include <pthread.h>
+ #include <sched.h>
+#endif
+
+#include "tdd.h"
+#include "tddThreads.h"
+
+TDD_LIBRARY_LOCAL_BEGIN
+namespace TDD { namespace Stress {
+
+class Options
+{
+	unsigned int       m_yieldOneIn;
+	bool               m_pin;
+	unsigned long long m_seed;
+public:
+	Options() : m_yieldOneIn(0), m_pin(false), m_seed(0) {}
+
+	Options& RandomYields(unsigned int oneIn) { m_yieldOneIn = oneIn; return *this; } // yield before about 1 in oneIn iterations, and at that rate in Thread::MaybeYield()
+	Options& PinThreads(bool pin = true)      { m_pin = pin;          return *this; } // thread i runs only on CPU i (modulo the number of CPUs)
+	Options& Seed(unsigned long long seed)    { m_seed = seed;        return *this; } // for the random yields; 0 => pick one
+
+	unsigned int       YieldOneIn() const { return m_yieldOneIn; }
+	bool               Pinned    () const { return m_pin; }
+	unsigned long long GetSeed   () const { return m_seed; }
+};
+
+class Thread // what the body of a TEST_STRESS gets: which thread it's running on, and which iteration it's on
+{
+	unsigned long long m_random; // xorshift64
+	unsigned int       m_yieldOneIn;
+public:
+	const unsigned int index, threads;
+	unsigned long long iteration;
+
+	Thread(unsigned int i, unsigned int n, unsigned long long seed, unsigned int yieldOneIn)
+		: m_random(seed * 0x9E3779B97F4A7C15ull + i + 1), m_yieldOneIn(yieldOneIn), index(i), threads(n), iteration(0) {}
+
+	unsigned long long Random()
+	{
+		m_random ^= m_random << 13;
+		m_random ^= m_random >> 7;
+		m_random ^= m_random << 17;
+		return m_random;
+	}
+	void MaybeYield() // a point at which to (sometimes) let another thread in, if RandomYields was asked for
+	{
+		if (m_yieldOneIn != 0 && Random() % m_yieldOneIn == 0)
+			std::this_thread::yield();
+	}
+private:
+	Thread& operator=(const Thread&) = delete;
+};
+
+namespace Details
+{
+	class SpinBarrier // releases all the threads at once, so that they collide as much as possible
+	{
+		std::atomic<unsigned int> m_arrived;
+		const unsigned int        m_count;
+	public:
+		explicit SpinBarrier(unsigned int count) : m_arrived(0), m_count(count) {}
+		void ArriveAndWait()
+		{
+			m_arrived.fetch_add(1, std::memory_order_acq_rel);
+			for (unsigned int spins = 0; m_arrived.load(std::memory_order_acquire) < m_count; ++spins)
+				if (spins > 10000) // more threads than CPUs: let the others get here
+					std::this_thread::yield();
+		}
+	};
+
+	inline void Pin(std::thread& t, unsigned int index)
+	{
+		const unsigned int cpus = std::thread::hardware_concurrency();
+		if (cpus == 0)
+			return;
+	#ifdef _WIN32
+		if (index % cpus < sizeof(DWORD_PTR) * 8)
+			SetThreadAffinityMask(t.native_handle(), DWORD_PTR(1) << (index % cpus));
+	#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(index % cpus, &set);
+		pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+	#else
+		(void)t; (void)index; // not supported, e.g., macOS has no affinity API
+	#endif
+	}
+
+#ifdef _CPPUNWIND
+	// the first failure, from whichever thread, rethrown on the test's thread
+	class Failure : public TddException
+	{
+		std::string m_file, m_text;
+	public:
+		Failure(unsigned long line, const std::string& file, const std::string& text) : TddException(line, ""), m_file(file), m_text(text) { SetFile(m_file.c_str()); }
+		Failure(const Failure& f) : TddException(f), m_file(f.m_file), m_text(f.m_text) { SetFile(m_file.c_str()); }
+		const char* GetExceptionText() const override { return m_text.c_str(); }
+	};
+#else
+	// without exceptions, a thread's recorded failures come here rather than straight to the test, so that the first one
+	// stops the threads; fail(line, file, text) returns false if it wasn't the first, which then goes to the test as it is
+	template<class F> class StoppingSink : public ThreadFailureSink
+	{
+		ThreadFailureSink& m_test;
+		F&                 m_fail;
+	public:
+		StoppingSink(ThreadFailureSink& test, F& fail) : m_test(test), m_fail(fail) {}
+		void Record(unsigned long line, const char* file, const char* error) override
+		{
+			if (!m_fail(line, file, error))
+				m_test.Record(line, file, error);
+		}
+		const UnitTestInfo* Test() const override { return m_test.Test(); }
+	};
+#endif
+
+	inline std::string Milliseconds(std::chrono::steady_clock::duration d) // e.g. "12.345"
+	{
+		const long long us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+		const std::string frac = std::to_string(1000 + us % 1000);
+		return std::to_string(us / 1000) + "." + frac.substr(1);
+	}
+}
+
+template<class T> void Run(T& test, void (T::*body)(Thread&), unsigned int threads, unsigned long long iterations, const Options& options)
+{
+	struct Result
+	{
+		unsigned long long                  iterations = 0;
+		std::chrono::steady_clock::duration elapsed{};
+	};
+	std::vector<Result> results(threads);
+	Details::SpinBarrier barrier(threads);
+	std::atomic<bool> stop(false);
+
+	// the first failure wins
+	std::atomic<bool>  failed(false);
+	unsigned int       failedThread = 0;
+	unsigned long long failedIteration = 0;
+	unsigned long      failedLine = 0;
+	std::string        failedFile, failedText;
+
+	const unsigned long long seed = options.GetSeed() != 0 ? options.GetSeed()
+		: static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+
+	TestContext context = TestContext::Capture(); // recorded failures (Expect::, etc.) on the threads are queued for the test
+
+	auto Worker = [&](unsigned int index)
+	{
+		TestContext::Scope scope(context);
+		Thread thread(index, threads, seed, options.YieldOneIn());
+		barrier.ArriveAndWait();
+		const auto start = std::chrono::steady_clock::now();
+		auto Fail = [&](unsigned long line, const char* file, const char* text) // true if it's the first failure
+		{
+			const bool first = failed.exchange(true) == false;
+			if (first) {
+				failedThread = index;
+				failedIteration = thread.iteration;
+				failedLine = line;
+				failedFile = file;
+				failedText = text;
+			}
+			stop.store(true, std::memory_order_relaxed);
+			return first;
+		};
+	#ifndef _CPPUNWIND
+		Details::StoppingSink<decltype(Fail)> sink(context, Fail);
+		TestContext::Scope stopping(sink);
+	#endif
+		for (; thread.iteration < iterations && !stop.load(std::memory_order_relaxed); ++thread.iteration)
+		{
+			thread.MaybeYield();
+		#ifdef _CPPUNWIND
+			try {
+				(test.*body)(thread);
+			} catch (TddException& e) {
+				Fail(e.GetLine(), e.GetFile(), e.GetExceptionText());
+				break;
+			} catch (...) {
+				Fail(__LINE__, __FILE__, "unknown exception");
+				break;
+			}
+		#else
+			(test.*body)(thread); // a failure goes to Fail, through the sink
+		#endif
+		}
+		results[index].iterations = thread.iteration;
+		results[index].elapsed    = std::chrono::steady_clock::now() - start;
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	for (unsigned int i = 0; i < threads; ++i) {
+		workers.emplace_back(Worker, i);
+		if (options.Pinned())
+			Details::Pin(workers.back(), i);
+	}
+	for (auto& w : workers)
+		w.join();
+
+	for (unsigned int i = 0; i < threads; ++i) {
+		const long long us = std::chrono::duration_cast<std::chrono::microseconds>(results[i].elapsed).count();
+		const std::string message = "thread " + std::to_string(i) + ": " + std::to_string(results[i].iterations) + " iterations in "
+			+ Details::Milliseconds(results[i].elapsed) + " ms ("
+			+ (us > 0 ? std::to_string(results[i].iterations * 1000000 / static_cast<unsigned long long>(us)) : std::string("-")) + " per second)";
+		Verifier::Message(message.c_str());
+	}
+
+	if (failed) {
+		const std::string text = "thread " + std::to_string(failedThread) + " of " + std::to_string(threads) + ", iteration " + std::to_string(failedIteration)
+			+ " of " + std::to_string(iterations) + " (seed " + std::to_string(seed) + "): " + failedText;
+	#ifdef _CPPUNWIND
+		throw Details::Failure(failedLine, failedFile, text);
+	#else
+		Verifier::Verify(failedLine, failedFile.c_str(), false, text.c_str());
+	#endif
+	}
+}
+
+}} // namespace TDD::Stress
+TDD_LIBRARY_LOCAL_END
+
+#define TEST_STRESS(methodName, threads, iterations, ...) TESTMETHOD(methodName) { ::TDD::Stress::Run(*this, &TheClass::methodName##_stress_body, threads, iterations, ::TDD::Stress::Options(__VA_ARGS__)); } void methodName##_stress_body(::TDD::Stress::Thread& thread)
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef TDDTHREADS_H
+#define TDDTHREADS_H
+
+// Failures on threads which a test starts. Without this, an assertion that fails on such a thread throws where nothing
+// catches it (so std::terminate ends the run), and a recorded failure (TDD_VERIFY without exceptions, Expect::, etc.)
+// races with the test's own thread. Instead:
+//
+//	TEST_METHOD(ChecksInParallel)
+//	{
+//		TDD::TestThread a([]() { Assert::AreEqual(1, CheckFirstHalf()); });  // like std::thread, but joins when destroyed
+//		TDD::TestThread b([]() { Assert::AreEqual(1, CheckSecondHalf()); });
+//	}
+//
+// or, for a thread pool or other executor, wrap the work in the test's context:
+//
+//	pool.Post(TDD::TestContext::Capture().Wrap([]() { Assert::IsTrue(Check()); }));
+//
+// Failures on those threads go into a lock-free queue, and are reported with the test that started them when it (or
+// TestInitialize, etc.) ends. A failure from a thread which outlives its test is reported when the next test ends.
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+#include "tdd.h"
+
+#ifndef TDD_HAS_THREAD_LOCAL
+ #error tddThreads.h needs thread-local storage (see TDD_THREAD_LOCAL in tdd.h): #define TDD_THREAD_LOCAL_STORAGE if there is some
+#endif
+
+#ifndef TDD_MAX_THREAD_FAILURES
+ #define TDD_MAX_THREAD_FAILURES 64 // queued at once; more than that are counted, but not kept
+#endif
+
+TDD_LIBRARY_LOCAL_BEGIN
+namespace TDD
+{
+
+// a bounded multi-producer queue, popped only on the test's thread; pushing neither blocks nor allocates
+class ThreadFailureQueue : public ThreadFailureSource
+{
+	struct Slot
+	{
+		std::atomic<size_t> sequence; // == position + 1 once it's been written
+		const char*         group;
+		const char*         testname;
+		const char*         classFile;
+		unsigned long       line;
+		char file [TDD_MAX_RECORDED_FAILURE_FILE];
+		char error[TDD_MAX_RECORDED_FAILURE_TEXT];
+	};
+	Slot                      m_slots[TDD_MAX_THREAD_FAILURES];
+	std::atomic<size_t>       m_tail;    // where the next failure goes
+	size_t                    m_head;    // the next to report
+	std::atomic<unsigned int> m_dropped;
+
+	ThreadFailureQueue() : m_tail(0), m_head(0), m_dropped(0)
+	{
+		for (size_t i = 0; i < TDD_MAX_THREAD_FAILURES; ++i)
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+public:
+	TDD_LIBRARY_LOCAL static ThreadFailureQueue& Instance()
+	{
+		static ThreadFailureQueue s_queue;
+		return s_queue;
+	}
+
+	void Push(const UnitTestInfo& uti, unsigned long line, const char* file, const char* error)
+	{
+		size_t position = m_tail.load(std::memory_order_relaxed);
+		Slot* slot;
+		for (;;) {
+			slot = &m_slots[position % TDD_MAX_THREAD_FAILURES];
+			const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			if (sequence == position) {
+				if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break; // it's ours
+			} else if (sequence < position) {
+				m_dropped.fetch_add(1, std::memory_order_relaxed); // full
+				return;
+			} else {
+				position = m_tail.load(std::memory_order_relaxed); // another thread took it
+			}
+		}
+		slot->group     = uti.group;
+		slot->testname  = uti.testname;
+		slot->classFile = uti.class_file;
+		slot->line      = line;
+		RecordedFailures::CopyFile (slot->file,  TDD_MAX_RECORDED_FAILURE_FILE, file);
+		RecordedFailures::CopyError(slot->error, TDD_MAX_RECORDED_FAILURE_TEXT, error);
+		slot->sequence.store(position + 1, std::memory_order_release);
+	}
+
+	void ReportAll(Reporter& r, const UnitTestInfo* current) override
+	{
+		for (;;) { // stops at a failure which is still being written: it'll be reported next time
+			Slot& slot = m_slots[m_head % TDD_MAX_THREAD_FAILURES];
+			if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+				break;
+			UnitTestInfo uti(slot.group, slot.testname, slot.classFile);
+			r.ForEachFailure(TestFailure(&uti, slot.line, slot.file, slot.error));
+			slot.sequence.store(m_head + TDD_MAX_THREAD_FAILURES, std::memory_order_release);
+			++m_head;
+		}
+		if (m_dropped.exchange(0, std::memory_order_relaxed) != 0 && current)
+			r.ForEachFailure(TestFailure(current, __LINE__, __FILE__, "more failures on other threads than fit in TDD_MAX_THREAD_FAILURES"));
+	}
+private:
+	ThreadFailureQueue(const ThreadFailureQueue&) = delete;
+	ThreadFailureQueue& operator=(const ThreadFailureQueue&) = delete;
+};
+
+class TestContext : public ThreadFailureSink // the test which is running, captured so that other threads can report to it
+{
+	UnitTestInfo m_test;
+public:
+	explicit TestContext(const UnitTestInfo& uti) : m_test(&uti) {}
+
+	static TestContext Capture() // on the test's own thread
+	{
+		Verifier::ThreadFailures() = &ThreadFailureQueue::Instance();
+		const UnitTestInfo* uti = Verifier::CurrentTest();
+		return TestContext(uti ? *uti : UnitTestInfo("<no test>", "<no test>"));
+	}
+
+	class Scope // while it lives, recorded failures on this thread go to the context's test
+	{
+		ThreadFailureSink* m_outer;
+	public:
+		explicit Scope(ThreadFailureSink& sink) : m_outer(Verifier::ThreadSink()) { Verifier::ThreadSink() = &sink; }
+		~Scope() { Verifier::ThreadSink() = m_outer; }
+	private:
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+	template<class F> void Run(F&& f) // runs f on this thread, reporting its failures (and any exception which ends it) to the test
+	{
+		Scope scope(*this);
+	#ifdef _CPPUNWIND
+		try {
+			f();
+		} catch (TddException& e) {
+			Record(e.GetLine(), e.GetFile(), e.GetExceptionText());
+		} catch (...) {
+			Record(__LINE__, __FILE__, "unknown exception on a thread started by the test");
+		}
+	#else
+		f();
+	#endif
+	}
+	template<class F> auto Wrap(F f) const // for executors: a callable which does the same as Run (and returns nothing)
+	{
+		return [context = *this, f = std::move(f)](auto&&... args) mutable { context.Run([&]() { f(std::forward<decltype(args)>(args)...); }); };
+	}
+
+public: // ThreadFailureSink
+	void Record(unsigned long line, const char* file, const char* error) override { ThreadFailureQueue::Instance().Push(m_test, line, file, error); }
+	const UnitTestInfo* Test() const override { return &m_test; }
+};
+
+class TestThread // a std::thread whose failures are reported with the test that started it, and which joins when it's destroyed
+{
+	std::thread m_thread;
+public:
+	TestThread() noexcept {}
+	template<class F, class... Args> explicit TestThread(F&& f, Args&&... args) : m_thread(TestContext::Capture().Wrap(std::forward<F>(f)), std::forward<Args>(args)...) {}
+	TestThread(TestThread&&) noexcept = default;
+	TestThread& operator=(TestThread&& t) noexcept
+	{
+		if (m_thread.joinable())
+			m_thread.join();
+		m_thread = std::move(t.m_thread);
+		return *this;
+	}
+	~TestThread()
+	{
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	bool joinable() const noexcept { return m_thread.joinable(); }
+	void join() { m_thread.join(); }
+	std::thread::id get_id() const noexcept { return m_thread.get_id(); }
+};
+
+} // namespace TDD
+TDD_LIBRARY_LOCAL_END
+
+#endif
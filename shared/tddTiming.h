@@ -0,0 +1,163 @@
+#ifndef TDDTIMING_H
+#define TDDTIMING_H
+
+// Timing for Assert::CompletesWithin and Assert::NoSlowerThanBaseline. A single timing is mostly noise, so a measurement:
+//	- warms up (caches, branch predictors, lazy initialization) before it starts timing,
+//	- times batches of calls, so that each sample is well above the clock's resolution,
+//	- takes at least TDD_TIMING_MIN_SAMPLES samples, and more until the median is known to within about 1% (or the time
+//	  budget runs out),
+//	- rejects samples which are far slower than the rest (another process got the CPU, a page fault, etc.), and
+//	- reports the median, which one slow sample can't move.
+// An assertion which finds the code too slow measures again, and fails only if the second measurement agrees.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifndef TDD_TIMING_MIN_SAMPLES
+ #define TDD_TIMING_MIN_SAMPLES 15
+#endif
+#ifndef TDD_TIMING_MAX_SAMPLES
+ #define TDD_TIMING_MAX_SAMPLES 1000
+#endif
+#ifndef TDD_TIMING_BUDGET_MS
+ #define TDD_TIMING_BUDGET_MS 500 // per measurement, after the warmup; the minimum samples are taken regardless
+#endif
+#ifndef TDD_TIMING_WARMUP_MS
+ #define TDD_TIMING_WARMUP_MS 20
+#endif
+#ifndef TDD_TIMING_MIN_SAMPLE_NS
+ #define TDD_TIMING_MIN_SAMPLE_NS 200000 // fast code is called repeatedly for each sample, to take at least this long
+#endif
+
+namespace TDD { namespace Timing {
+
+struct Measurement // all in nanoseconds per call
+{
+	double             median = 0, low = 0, high = 0; // low - high: 95% confidence interval for the median
+	unsigned int       samples = 0, rejected = 0;
+	unsigned long long callsPerSample = 1;
+};
+
+namespace Details
+{
+	typedef std::chrono::steady_clock Clock;
+
+	inline double Nanoseconds(Clock::duration d) { return std::chrono::duration<double, std::nano>(d).count(); }
+
+	// the median of sorted samples, and its confidence interval from the order statistics around it
+	inline void Summarize(const std::vector<double>& sorted, Measurement& m)
+	{
+		const size_t n = sorted.size();
+		if (n == 0)
+			return;
+		m.median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+		const double spread = 1.96 * std::sqrt(static_cast<double>(n)) / 2;
+		const size_t lo = static_cast<size_t>(std::max(0.0, std::floor(n / 2.0 - spread)));
+		const size_t hi = static_cast<size_t>(std::min(n - 1.0, std::ceil(n / 2.0 + spread)));
+		m.low  = sorted[lo];
+		m.high = sorted[hi];
+	}
+
+	// drops samples more than 5 (scaled) median absolute deviations slower than the median: interference only ever slows code down
+	inline unsigned int RejectOutliers(std::vector<double>& sorted)
+	{
+		Measurement m;
+		Summarize(sorted, m);
+		std::vector<double> deviations;
+		deviations.reserve(sorted.size());
+		for (double s : sorted)
+			deviations.push_back(std::abs(s - m.median));
+		std::sort(deviations.begin(), deviations.end());
+		const double mad = deviations[deviations.size() / 2] * 1.4826;
+		const double limit = m.median + 5 * std::max(mad, m.median * 0.001);
+		const size_t kept = static_cast<size_t>(std::upper_bound(sorted.begin(), sorted.end(), limit) - sorted.begin());
+		const unsigned int rejected = static_cast<unsigned int>(sorted.size() - kept);
+		sorted.resize(kept);
+		return rejected;
+	}
+}
+
+template<class F> Measurement Measure(F& f)
+{
+	using namespace Details;
+	Measurement m;
+
+	// warm up, and estimate how long a call takes
+	unsigned long long calls = 0;
+	const Clock::time_point warmupStart = Clock::now();
+	Clock::duration warmup{};
+	do {
+		f();
+		++calls;
+		warmup = Clock::now() - warmupStart;
+	} while (warmup < std::chrono::milliseconds(TDD_TIMING_WARMUP_MS));
+	const double perCall = Nanoseconds(warmup) / static_cast<double>(calls);
+	if (perCall < TDD_TIMING_MIN_SAMPLE_NS)
+		m.callsPerSample = static_cast<unsigned long long>(TDD_TIMING_MIN_SAMPLE_NS / std::max(perCall, 1.0)) + 1;
+
+	std::vector<double> samples, sorted;
+	samples.reserve(TDD_TIMING_MAX_SAMPLES);
+	const Clock::time_point start = Clock::now();
+	while (samples.size() < TDD_TIMING_MAX_SAMPLES)
+	{
+		const Clock::time_point before = Clock::now();
+		for (unsigned long long i = 0; i < m.callsPerSample; ++i)
+			f();
+		samples.push_back(Nanoseconds(Clock::now() - before) / static_cast<double>(m.callsPerSample));
+
+		if (samples.size() < TDD_TIMING_MIN_SAMPLES || samples.size() % 5 != 0)
+			continue;
+		if (Clock::now() - start > std::chrono::milliseconds(TDD_TIMING_BUDGET_MS))
+			break;
+		sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		Measurement interim;
+		Summarize(sorted, interim);
+		if (interim.high - interim.low <= interim.median * 0.02) // +/- 1%
+			break;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	m.rejected = RejectOutliers(samples);
+	m.samples  = static_cast<unsigned int>(samples.size());
+	Summarize(samples, m);
+	return m;
+}
+
+// measures f; if its median is over the limit, measures again, and keeps the faster measurement; true => still over the limit
+template<class F> bool Exceeds(F& f, double limitNs, Measurement& m)
+{
+	m = Measure(f);
+	if (m.median <= limitNs)
+		return false;
+	const Measurement again = Measure(f);
+	if (again.median < m.median)
+		m = again;
+	return m.median > limitNs;
+}
+
+inline std::string Format(double ns) // e.g. "12.3 us"
+{
+	const char* unit = "ns";
+	if      (ns >= 1e9) { ns /= 1e9; unit = "s";  }
+	else if (ns >= 1e6) { ns /= 1e6; unit = "ms"; }
+	else if (ns >= 1e3) { ns /= 1e3; unit = "us"; }
+	char text[32];
+	snprintf(text, sizeof(text), "%.3g %s", ns, unit);
+	return text;
+}
+
+inline std::string Describe(const Measurement& m) // e.g. "median 12.3 us (95% interval 12.2 us - 12.5 us; 40 samples of 17 calls, 2 outliers rejected)"
+{
+	return "median " + Format(m.median) + " (95% interval " + Format(m.low) + " - " + Format(m.high) + "; " + std::to_string(m.samples)
+	     + " samples of " + std::to_string(m.callsPerSample) + (m.callsPerSample == 1 ? " call" : " calls")
+	     + (m.rejected ? ", " + std::to_string(m.rejected) + (m.rejected == 1 ? " outlier" : " outliers") + " rejected)" : std::string(")"));
+}
+
+}} // namespace TDD::Timing
+
+#endif